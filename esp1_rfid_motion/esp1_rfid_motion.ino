@@ -36,12 +36,26 @@
 #include <LiquidCrystal_I2C.h>
 
 #include <WiFiMqttClient.h>
+#include <LatencyMetrics.h>
+#include <ConfigStore.h>
+#include <UidCache.h>
+#include <AccessSession.h>
+#include <LcdBuffer.h>
+#include <CoopScheduler.h>
+#include <OtaUpdater.h>
+#include <AuditLog.h>
 
 // ---------------- Network configuration ----------------
 
 /** @brief WiFi + MQTT client wrapper */
 WifiMqttClient net;
 
+/** @brief Per-stage latency histograms, published on metrics/latency. */
+LatencyMetrics metrics;
+
+/** @brief Cooperative task scheduler driving loop(). */
+CoopScheduler sched;
+
 /** @brief WiFi SSID */
 constexpr char WIFI_SSID[] = "Mathias2.4";
 /** @brief WiFi password */
@@ -59,6 +73,15 @@ constexpr char MQTT_PASS[] = "potter";
 /** @brief Unique device identifier used in MQTT topics */
 constexpr char DEVICE_ID[] = "door1";
 
+/** @brief Running firmware version, compared against OTA manifests. */
+constexpr char FW_VERSION[] = "1.0.0";
+
+/** @brief Chunked MQTT firmware updater. */
+OtaUpdater ota;
+
+/** @brief Flash-resident audit trail with acknowledged batch upload. */
+AuditLog audit;
+
 // -----------------------------------------------------------------------------
 // Pin configuration | esp1&2.fzz
 // -----------------------------------------------------------------------------
@@ -69,6 +92,9 @@ constexpr uint8_t RFID_SS_PIN  = 15;
 /** @brief RC522 Reset pin (D0 / GPIO16). */
 constexpr uint8_t RFID_RST_PIN = 16;
 
+/** @brief RC522 IRQ pin (D4 / GPIO2), active low. */
+constexpr uint8_t RFID_IRQ_PIN = 2;
+
 /** @brief Motion sensor pin (D3 / GPIO0). */
 constexpr uint8_t MOTION_PIN = 0;
 
@@ -93,20 +119,45 @@ constexpr uint8_t LCD_ADDRESS = 0x27;
 
 // -----------------------------------------------------------------------------
 // Timing configuration
+//
+// Compiled-in values are defaults; each can be overridden at runtime via a
+// retained message on the "config" topic (see ConfigStore) and the override
+// is persisted across reboots.
 // -----------------------------------------------------------------------------
 
-/** @brief Duration (ms) to display text before resetting. */
+/** @brief Default duration (ms) to display text before resetting. */
 constexpr uint32_t DISPLAY_MS = 3000;
 
-/** @brief Duration (ms) to keep LCD backlight on after motion. */
+/** @brief Default duration (ms) to keep LCD backlight on after motion. */
 constexpr uint32_t DISPLAY_BACKLIGHT_MS = 5000;
 
-/** @brief Time window (ms) for entering PIN after RFID success. */
+/** @brief Default time window (ms) for entering PIN after RFID success. */
 constexpr uint32_t PIN_TIME_MS = 15000;
 
 /** @brief Door unlock display duration (ms). */
 constexpr uint32_t UNLOCK_TIME_MS = 5000;
 
+/** @brief Default idle time without motion (ms) before power-save mode. */
+constexpr uint32_t IDLE_SLEEP_AFTER_MS = 5UL * 60UL * 1000UL;
+
+/** @brief PIR poll interval (ms) while in power-save mode. */
+constexpr uint32_t IDLE_POLL_MS = 50;
+
+/** @brief Runtime-tunable configuration store. */
+ConfigStore cfg;
+
+/** @brief Config ID: text display duration. */
+int8_t cfgDisplayMs = -1;
+
+/** @brief Config ID: backlight hold duration. */
+int8_t cfgBacklightMs = -1;
+
+/** @brief Config ID: PIN entry window. */
+int8_t cfgPinTimeMs = -1;
+
+/** @brief Config ID: idle time before power-save mode. */
+int8_t cfgIdleSleepMs = -1;
+
 // -----------------------------------------------------------------------------
 // Global objects
 // -----------------------------------------------------------------------------
@@ -117,29 +168,28 @@ MFRC522 mfrc522(RFID_SS_PIN, RFID_RST_PIN);
 /** @brief I2C LCD instance. */
 LiquidCrystal_I2C lcd(LCD_ADDRESS, LCD_COLUMNS, LCD_ROWS);
 
+/**
+ * @brief Shadow-buffered LCD writer.
+ *
+ * Text updates land in a RAM framebuffer and only changed cells are
+ * sent over I2C, a few per loop pass, so the masked-PIN update in the
+ * keypad/beep handler no longer stalls MQTT and RFID processing.
+ */
+LcdBuffer lcdBuf(lcd);
+
 // -----------------------------------------------------------------------------
 // Global state
 // -----------------------------------------------------------------------------
 
 /**
- * @brief Access result enumeration.
+ * @brief Shared access session state machine.
+ *
+ * Replaces the old rfidAccess / accessGranted / textshown globals.
+ * Local transitions are broadcast on "session/state" so the keypad and
+ * actuator nodes follow within one MQTT delivery; LCD rendering happens
+ * in handleSessionChange().
  */
-enum class AccessResult : uint8_t {
-  Denied,   /**< Access denied */
-  Granted   /**< Access granted */
-};
-
-/** @brief Result of RFID authentication. */
-AccessResult rfidAccess;
-
-/** @brief Result of PIN verification. */
-AccessResult accessGranted;
-
-/** @brief Indicates whether a status message is currently displayed. */
-bool textshown = false;
-
-/** @brief Timestamp (ms) when the displayed text should expire. */
-uint32_t showTextUntil = 0;
+AccessSession session;
 
 /** @brief Timestamp (ms) when LCD backlight should turn off. */
 uint32_t showDisplayUntil = 0;
@@ -147,6 +197,12 @@ uint32_t showDisplayUntil = 0;
 /** @brief Indicates whether motion is currently considered active. */
 bool motionActive = false;
 
+/** @brief Indicates whether the node is in power-save mode. */
+bool powerSaving = false;
+
+/** @brief Timestamp (ms) of the last detected motion. */
+uint32_t lastMotionMs = 0;
+
 /**
  * @brief Masked PIN buffer shown on LCD (max 4 digits + null terminator).
  *
@@ -154,47 +210,146 @@ bool motionActive = false;
  */
 static char enteredPins[5] = "    ";
 
+/**
+ * @brief Flash-backed cache of recently authorized UID hashes.
+ *
+ * A cache hit skips the broker round trip and prompts for the PIN
+ * immediately; the backend request is still published for auditing.
+ */
+UidCache uidCache;
+
+/** @brief UID of the most recently scanned card (hex string). */
+static char lastUid[21] = "";
+
+/**
+ * @brief Set by the RC522 IRQ line when a card has been received.
+ *
+ * The ISR only raises this flag; all SPI traffic happens in loop()
+ * context via handleRFID().
+ */
+volatile bool rfidCardDetected = false;
+
+/** @brief Timestamp (ms) of the next receiver re-arm command. */
+uint32_t nextRfidRearm = 0;
+
+/**
+ * @brief Correlation ID of the access request awaiting a response.
+ *
+ * Zero when no request is in flight. The backend echoes the request's
+ * "seq" in its response, so matching is exact: a late response to the
+ * current request is still accepted, and a response to a superseded
+ * request (the user scanned again) is discarded.
+ */
+uint32_t pendingRequestSeq = 0;
+
+/** @brief Interval (ms) between receiver re-arm commands. */
+constexpr uint32_t RFID_REARM_MS = 100;
+
+// -----------------------------------------------------------------------------
+// Topic IDs (assigned by WifiMqttClient::subscribeTopic() in setup())
+// -----------------------------------------------------------------------------
+
+/** @brief Topic ID for "access/response". */
+int8_t topicAccessResponse = -1;
+
+/** @brief Topic ID for "access/keypad_response". */
+int8_t topicKeypadResponse = -1;
+
+/** @brief Topic ID for "keypad/beep". */
+int8_t topicKeypadBeep = -1;
+
+/** @brief Topic ID for "access/revoke". */
+int8_t topicAccessRevoke = -1;
+
+/** @brief Topic ID for "config" (retained configuration overrides). */
+int8_t topicConfig = -1;
+
+/** @brief Topic ID for "session/state" (peer state-sync broadcasts). */
+int8_t topicSessionState = -1;
+
+/** @brief Topic ID for "ota/manifest" (firmware announcements). */
+int8_t topicOtaManifest = -1;
+
+/** @brief Topic ID for "ota/chunk" (binary firmware chunks). */
+int8_t topicOtaChunk = -1;
+
+/** @brief Topic ID for "audit/ack" (audit batch acknowledgments). */
+int8_t topicAuditAck = -1;
+
 // -----------------------------------------------------------------------------
 // Helper functions
 // -----------------------------------------------------------------------------
 
 /**
- * @brief Clears an LCD line and prints a flash-resident string.
+ * @brief Prints a flash-resident string on an LCD line.
+ *
+ * Writes to the shadow framebuffer only; lcdBuf.loop() carries the
+ * changed cells to the glass in the background.
  *
  * @param msg Flash string (use F("...")).
  * @param line LCD row index.
  */
 void lcdPrintLine(const __FlashStringHelper* msg, uint8_t line) {
-  lcd.setCursor(0, line);
-  lcd.print("                ");   // Overwrite entire row to remove old content
-  lcd.setCursor(0, line);
-  lcd.print(msg);
+  lcdBuf.printLine(msg, line);
 }
 
 /**
- * @brief Clears an LCD line and prints a RAM-resident string.
+ * @brief Prints a RAM-resident string on an LCD line.
  *
  * @param msg C-string to print.
  * @param line LCD row index.
  */
 void lcdPrintLine(const char* msg, uint8_t line) {
-  lcd.setCursor(0, line);
-  lcd.print("                ");   // Clear row to avoid leftover characters
-  lcd.setCursor(0, line);
-  lcd.print(msg);
+  lcdBuf.printLine(msg, line);
 }
 
 /**
- * @brief Forces the system back into locked idle state.
+ * @brief Renders the LCD for every session state change.
  *
- * Resets access state, clears temporary flags,
- * and restores the default idle LCD message.
+ * Registered as the AccessSession change handler, so local events and
+ * peer broadcasts produce identical displays (e.g. the actuator's
+ * fast-path unlock shows "Access Granted" here without a backend hop).
+ *
+ * @param from Previous session state.
+ * @param to New session state.
+ * @param remote true if the change came from a peer broadcast.
  */
-static void forceLock() {
-  textshown = false;                     // Exit message display mode
-  rfidAccess = AccessResult::Denied;     // Clear RFID authorization state
-  accessGranted = AccessResult::Denied;  // Clear PIN authorization state
-  lcdPrintLine(F("Scan RFID card"), 0);  // Restore idle prompt
+void handleSessionChange(AccessState from, AccessState to, bool remote) {
+  (void)from;
+  (void)remote;
+
+  switch (to) {
+    case AccessState::Idle:
+      lcdPrintLine(F("Scan RFID card"), 0);  // Restore idle prompt
+      lcdPrintLine("", 1);                   // Clear masked PIN row
+      break;
+    case AccessState::RfidPending:
+      lcdPrintLine(F("Connecting..."), 0);
+      break;
+    case AccessState::PinEntry:
+      lcdPrintLine(F("Enter PIN:"), 0);
+      lcdPrintLine("", 1);                   // Fresh masked PIN row
+      break;
+    case AccessState::Unlocked:
+      lcdPrintLine(F("Access Granted"), 0);
+      break;
+    case AccessState::Lockout:
+      lcdPrintLine(F("Access Denied"), 0);
+      break;
+  }
+}
+
+/**
+ * @brief Applies the (possibly overridden) timing config to the session.
+ *
+ * Called after cfg.begin() and again whenever a config message is
+ * applied, so retained overrides reach the running state machine.
+ */
+void applySessionTimeouts() {
+  session.setTimeout(AccessState::RfidPending, cfg.get(cfgDisplayMs));
+  session.setTimeout(AccessState::PinEntry, cfg.get(cfgPinTimeMs));
+  session.setTimeout(AccessState::Unlocked, UNLOCK_TIME_MS);
+  session.setTimeout(AccessState::Lockout, cfg.get(cfgDisplayMs));
 }
 
 /**
@@ -238,10 +393,27 @@ void callback(char* topic, byte* payload, unsigned int length) {
   // Ignore empty MQTT messages
   if (length == 0) return;
 
+  // Resolve the topic to its registered ID (allocation-free)
+  const int8_t topicId = net.matchTopic(topic);
+  if (topicId < 0) return;
+
+  // Peer state broadcasts are binary; handle them before JSON parsing
+  if (topicId == topicSessionState) {
+    session.applyRemote(payload, length);
+    return;
+  }
+
+  // Firmware chunks are binary as well
+  if (topicId == topicOtaChunk) {
+    ota.handleChunk(payload, length);
+    return;
+  }
+
   StaticJsonDocument<512> doc;
 
-  // Deserialize JSON payload into document
-  DeserializationError err = deserializeJson(doc, payload, length);
+  // Filtered in-situ parse: only the fields this topic's handler
+  // declared in setup() are materialized
+  DeserializationError err = net.parseJson(topicId, payload, length, doc);
 
   // Abort if JSON parsing fails
   if (err) {
@@ -253,82 +425,86 @@ void callback(char* topic, byte* payload, unsigned int length) {
   // ---------------------------------------------------------------------------
   // RFID access response
   // ---------------------------------------------------------------------------
-  if (strcmp(topic, net.makeTopic("access/response").c_str()) == 0) {
-
-    // Timestamp when request was sent (provided by backend)
-    uint32_t requestMs = doc["sent_ts_ms"] | 0;
+  if (topicId == topicAccessResponse) {
 
-    // Compute round-trip delay to detect stale responses
-    uint32_t deltaMs = millis() - requestMs;
+    // Correlation ID echoed by the backend (0 = legacy backend)
+    uint32_t responseSeq = doc["seq"] | 0;
 
+    // Round-trip delay, kept as a diagnostic only
+    uint32_t requestMs = doc["sent_ts_ms"] | 0;
     Serial.printf(
       "Request/Response time diff: %lu ms\n",
-      deltaMs
+      (unsigned long)(millis() - requestMs)
     );
 
-    // Ignore responses that took too long to arrive
-    if (deltaMs > DISPLAY_MS) {
-      Serial.println("Took too long to respond");
+    // Discard responses to superseded requests; a response matching the
+    // in-flight request is accepted no matter how late it arrives
+    if (responseSeq != 0 && responseSeq != pendingRequestSeq) {
+      Serial.printf("Stale response (seq %lu, expected %lu)\n",
+                    (unsigned long)responseSeq,
+                    (unsigned long)pendingRequestSeq);
       return;
     }
 
-    // Extract access decision from JSON payload
-    rfidAccess = (doc["response"]["hasAccess"] | false)
-      ? AccessResult::Granted
-      : AccessResult::Denied;
+    // Request is no longer in flight
+    pendingRequestSeq = 0;
 
-    Serial.println("UID match: waiting for PIN...");
+    // Close the publish -> response interval; time the LCD update next
+    metrics.stageEnd(LatencyStage::PublishToResponse);
+    metrics.stageStart(LatencyStage::ResponseToLcd);
+
+    // Extract access decision from JSON payload
+    const bool hasAccess = doc["response"]["hasAccess"] | false;
 
     // Handle denied RFID access immediately
-    if (rfidAccess != AccessResult::Granted) {
-      lcdPrintLine(F("Access Denied"), 0);
-      textshown = true;
-      showTextUntil = millis() + DISPLAY_MS;
+    if (!hasAccess) {
+      session.transition(AccessState::Lockout);
+      metrics.stageEnd(LatencyStage::ResponseToLcd);
       return;
     }
 
+    Serial.println("UID match: waiting for PIN...");
+
+    // Remember this UID so a repeat scan is decided locally
+    if (lastUid[0] != '\0') {
+      uidCache.insert(lastUid);
+    }
+
     // Prompt user to enter PIN after successful RFID
-    lcdPrintLine(F("Enter PIN:"), 0);
-    textshown = true;
-    showTextUntil = millis() + PIN_TIME_MS;
-    
-  } 
+    session.transition(AccessState::PinEntry);
+    metrics.stageEnd(LatencyStage::ResponseToLcd);
+
+  }
   // ---------------------------------------------------------------------------
   // Keypad PIN verification response
   // ---------------------------------------------------------------------------
-  else if (strcmp(topic, net.makeTopic("access/keypad_response").c_str()) == 0) {
+  else if (topicId == topicKeypadResponse) {
 
-    // Ignore PIN responses if RFID was not authorized
-    if (rfidAccess != AccessResult::Granted) return;
+    // Ignore PIN responses outside the keypad window
+    if (!session.is(AccessState::PinEntry)) return;
 
     // Extract PIN validation result
-    accessGranted = (doc["response"]["accessGranted"] | false)
-      ? AccessResult::Granted
-      : AccessResult::Denied;
+    const bool granted = doc["response"]["accessGranted"] | false;
 
     // Handle incorrect PIN
-    if (accessGranted != AccessResult::Granted) {
+    if (!granted) {
       Serial.println("Access Denied");
-      lcdPrintLine(F("Access Denied"), 0);
-      textshown = true;
-      showTextUntil = millis() + DISPLAY_MS;
+      session.transition(AccessState::Lockout);
       return;
     }
 
     // Handle successful authentication
     Serial.println("Access Granted");
-    lcdPrintLine(F("Access Granted"), 0);
-    textshown = true;
-    showTextUntil = millis() + UNLOCK_TIME_MS;
+    session.transition(AccessState::Unlocked);
 
   }
   // ---------------------------------------------------------------------------
   // Keypad visual feedback (keypress)
   // ---------------------------------------------------------------------------
-  else if (strcmp(topic, net.makeTopic("keypad/beep").c_str()) == 0) {
+  else if (topicId == topicKeypadBeep) {
 
-    // Only show keypad feedback after successful RFID
-    if (rfidAccess != AccessResult::Granted) return;
+    // Only show keypad feedback during the keypad window
+    if (!session.is(AccessState::PinEntry)) return;
 
     // Number of digits entered so far
     uint8_t pinLength = doc["data"]["pinlength"] | 0;
@@ -337,6 +513,43 @@ void callback(char* topic, byte* payload, unsigned int length) {
     makeEnteredPins(pinLength);
     lcdPrintLine(enteredPins, 1);
   }
+  // ---------------------------------------------------------------------------
+  // UID cache revocation (single UID or full flush)
+  // ---------------------------------------------------------------------------
+  else if (topicId == topicAccessRevoke) {
+
+    const char* uid = doc["data"]["uid"] | (const char*)nullptr;
+
+    if (uid != nullptr) {
+      // Revoke a single cached UID
+      Serial.printf("UID cache revoke: %s\n",
+        uidCache.revoke(uid) ? "removed" : "not cached");
+    } else {
+      // No UID given: flush the entire cache
+      uidCache.clear();
+      Serial.println("UID cache cleared");
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // Retained configuration overrides
+  // ---------------------------------------------------------------------------
+  else if (topicId == topicConfig) {
+    if (cfg.applyJson(doc) > 0) {
+      applySessionTimeouts();  // Push overridden timings into the session
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // Firmware update announcement
+  // ---------------------------------------------------------------------------
+  else if (topicId == topicOtaManifest) {
+    ota.handleManifest(doc);
+  }
+  // ---------------------------------------------------------------------------
+  // Audit batch acknowledgment
+  // ---------------------------------------------------------------------------
+  else if (topicId == topicAuditAck) {
+    audit.handleAck(doc["data"]["batch_id"] | 0);
+  }
 }
 
 /**
@@ -351,14 +564,64 @@ bool isDisplayActive(uint32_t now) {
   return (int32_t)(now - showDisplayUntil) < 0;
 }
 
+/**
+ * @brief Enters power-save mode after a long motion-free period.
+ *
+ * Powers down the RC522, drops WiFi into forced modem sleep, and
+ * leaves only the PIR poll running. The CPU idles in delay() between
+ * polls, so current draw falls to a fraction of active mode.
+ *
+ * This wiring has no GPIO16-to-RST strap, so true deep sleep is not
+ * available; modem sleep with the radio off is the closest mode that
+ * still allows a fast PIR-triggered resume.
+ */
+void enterPowerSave() {
+  Serial.println(F("Entering power-save mode"));
+
+  lcdBuf.flush();                // Glass matches the framebuffer when we stop
+  mfrc522.PCD_SoftPowerDown();   // RC522 keeps registers, stops the field
+  net.suspend();                 // MQTT disconnect + modem sleep
+  lcd.noBacklight();
+
+  powerSaving = true;
+}
+
+/**
+ * @brief Leaves power-save mode on PIR wake.
+ *
+ * Restores the RC522 and re-arms its IRQ, then restarts the network
+ * in the background; the non-blocking connect state machine brings
+ * MQTT back while the user is still approaching the reader.
+ */
+void leavePowerSave() {
+  Serial.println(F("Waking from power-save mode"));
+
+  mfrc522.PCD_SoftPowerUp();
+
+  // Reception interrupts survive soft power down, but clear and re-arm
+  // to be safe against a half-finished transceive
+  mfrc522.PCD_WriteRegister(MFRC522::ComIrqReg, 0x7F);
+  rfidCardDetected = false;
+  activateRfidReception();
+
+  net.resume();
+
+  powerSaving = false;
+}
+
 /**
  * @brief Handles motion-detected events.
  *
  * Activates LCD backlight and refreshes display timeout.
+ * Wakes the node when motion arrives during power-save mode.
  *
  * @param now Current time in milliseconds.
  */
 void onMotionDetected(uint32_t now) {
+  if (powerSaving) {
+    leavePowerSave();
+  }
+
   if (!motionActive) {
     motionActive = true;       // Mark motion as active
     Serial.println(F("Motion detected"));
@@ -366,7 +629,8 @@ void onMotionDetected(uint32_t now) {
   }
 
   // Extend backlight timeout while motion persists
-  showDisplayUntil = now + DISPLAY_BACKLIGHT_MS;
+  lastMotionMs = now;
+  showDisplayUntil = now + cfg.get(cfgBacklightMs);
 }
 
 /**
@@ -401,6 +665,29 @@ void updateMotionState(uint32_t now) {
   }
 }
 
+/**
+ * @brief Interrupt service routine for the RC522 IRQ line.
+ *
+ * Raises a flag consumed by loop(); no SPI access is performed
+ * in interrupt context.
+ */
+void IRAM_ATTR onRfidIrq() {
+  rfidCardDetected = true;
+}
+
+/**
+ * @brief Re-arms the RC522 receiver so a new card raises the IRQ line.
+ *
+ * Loads a REQA frame into the FIFO and starts a transceive; when a
+ * card answers, the receive interrupt fires. Must be repeated
+ * periodically because the transceive times out without a card.
+ */
+void activateRfidReception() {
+  mfrc522.PCD_WriteRegister(MFRC522::FIFODataReg, MFRC522::PICC_CMD_REQA);
+  mfrc522.PCD_WriteRegister(MFRC522::CommandReg, MFRC522::PCD_Transceive);
+  mfrc522.PCD_WriteRegister(MFRC522::BitFramingReg, 0x87);  // StartSend, 7-bit frame
+}
+
 /**
  * @brief Converts an RFID UID to a hexadecimal string.
  *
@@ -429,18 +716,14 @@ void uidToHexString(const MFRC522::Uid& uid, char* output, size_t outputSize) {
 }
 
 /**
- * @brief Handles RFID card detection and request publishing.
+ * @brief Handles an RFID card announced by the IRQ line.
  *
- * Detects new cards, reads UID, updates LCD,
- * and sends an MQTT access request.
+ * Reads the UID, updates the LCD, and sends an MQTT access
+ * request. Only called after the RC522 receive interrupt fired,
+ * so no SPI polling happens in the idle loop.
  */
 void handleRFID() {
 
-  // Exit if no new card is present
-  if (!mfrc522.PICC_IsNewCardPresent()) {
-    return;
-  }
-
   // Exit if card UID could not be read
   if (!mfrc522.PICC_ReadCardSerial()) {
     return;
@@ -450,10 +733,28 @@ void handleRFID() {
   uidToHexString(mfrc522.uid, uidString, sizeof(uidString));
 
   Serial.println(uidString);
-  lcdPrintLine(F("Connecting..."), 0);
 
-  textshown = true;
-  showTextUntil = millis() + DISPLAY_MS;
+  // Time the card read -> publish complete interval
+  metrics.stageStart(LatencyStage::CardToPublish);
+
+  // Remember the UID so the access response can cache it
+  strncpy(lastUid, uidString, sizeof(lastUid));
+
+  const bool cacheHit = uidCache.check(uidString);
+
+  if (cacheHit) {
+    // Cache hit: open the keypad window immediately, skipping the broker
+    // round trip. The access request is still published below so the
+    // backend can audit the scan and revoke the cached UID if needed.
+    Serial.println("UID cache hit: waiting for PIN...");
+    session.transition(AccessState::PinEntry);
+  } else {
+    // Cache miss: wait for the backend decision
+    session.transition(AccessState::RfidPending);
+  }
+
+  // Flash-resident audit record: on disk before the request goes out
+  audit.record(AuditEvent::RfidScan, cacheHit, uidString);
 
   // Build JSON payload for access request
   StaticJsonDocument<64> data;
@@ -464,9 +765,21 @@ void handleRFID() {
   bool ok = net.publishJson("access/request", data);
   Serial.println(ok ? "MQTT publish OK" : "MQTT publish FAILED");
 
+  metrics.stageEnd(LatencyStage::CardToPublish);
+
+  // Track the request's correlation ID; a second scan while a response
+  // is in flight simply supersedes the first request
+  if (ok) {
+    pendingRequestSeq = net.lastSeq();
+    metrics.stageStart(LatencyStage::PublishToResponse);
+  }
+
   // Properly halt card communication
   mfrc522.PICC_HaltA();
   mfrc522.PCD_StopCrypto1();
+
+  // Acknowledge all pending RC522 interrupts
+  mfrc522.PCD_WriteRegister(MFRC522::ComIrqReg, 0x7F);
 }
 
 /**
@@ -479,19 +792,42 @@ void setup() {
   delay(100); // Allow hardware to stabilize
   Serial.begin(115200);
 
-  rfidAccess = AccessResult::Denied;
-
   Wire.begin(I2C_SDA_PIN, I2C_SCL_PIN);
+  Wire.setClock(400000);  // The PCF8574 backpack handles fast-mode I2C
 
   lcd.init();
   lcd.noBacklight();
   lcd.clear();
+  lcdBuf.begin();
   lcdPrintLine(F("Scan RFID card"), 0);
 
   SPI.begin();
   mfrc522.PCD_Init();
 
-  Serial.println("RC522 initialized");
+  // Route the receive interrupt to the IRQ pin (active low)
+  pinMode(RFID_IRQ_PIN, INPUT_PULLUP);
+  mfrc522.PCD_WriteRegister(MFRC522::ComIEnReg, 0xA0);  // RxIRq, inverted IRQ output
+  mfrc522.PCD_WriteRegister(MFRC522::ComIrqReg, 0x7F);  // Clear pending interrupts
+  attachInterrupt(digitalPinToInterrupt(RFID_IRQ_PIN), onRfidIrq, FALLING);
+
+  Serial.println("RC522 initialized (IRQ mode)");
+
+  // Register tunable timings (compiled defaults + valid ranges),
+  // then load any overrides persisted from earlier config messages
+  cfgDisplayMs   = cfg.define("display_ms", DISPLAY_MS, 500, 60000);
+  cfgBacklightMs = cfg.define("backlight_ms", DISPLAY_BACKLIGHT_MS, 1000, 600000);
+  cfgPinTimeMs   = cfg.define("pin_time_ms", PIN_TIME_MS, 1000, 120000);
+  cfgIdleSleepMs = cfg.define("idle_sleep_ms", IDLE_SLEEP_AFTER_MS,
+                              60000, 86400000);
+  cfg.begin();
+
+  // Shared session state machine; LCD rendering lives in the handler
+  session.begin(net);
+  session.onChange(handleSessionChange);
+  applySessionTimeouts();
+
+  // Load persisted UID authorization cache
+  uidCache.begin();
 
   pinMode(MOTION_PIN, INPUT);
 
@@ -510,45 +846,159 @@ void setup() {
 
   net.setCallback(callback);
 
-  // Subscribe to required MQTT topics
-  Serial.printf("access/response MQTT subscribe %s\n", 
-    net.subscribe(net.makeTopic("access/response").c_str()) ? "OK" : "FAILED");
+  // Subscribe to required MQTT topics (registered for allocation-free dispatch)
+  topicAccessResponse = net.subscribeTopic("access/response");
+  Serial.printf("access/response MQTT subscribe %s\n",
+    topicAccessResponse >= 0 ? "OK" : "FAILED");
+
+  topicKeypadResponse = net.subscribeTopic("access/keypad_response");
+  Serial.printf("access/keypad_response MQTT subscribe %s\n",
+    topicKeypadResponse >= 0 ? "OK" : "FAILED");
+
+  topicKeypadBeep = net.subscribeTopic("keypad/beep");
+  Serial.printf("keypad/beep MQTT subscribe %s\n",
+    topicKeypadBeep >= 0 ? "OK" : "FAILED");
+
+  topicAccessRevoke = net.subscribeTopic("access/revoke");
+  Serial.printf("access/revoke MQTT subscribe %s\n",
+    topicAccessRevoke >= 0 ? "OK" : "FAILED");
+
+  topicConfig = net.subscribeTopic("config");
+  Serial.printf("config MQTT subscribe %s\n",
+    topicConfig >= 0 ? "OK" : "FAILED");
+
+  topicSessionState = net.subscribeTopic("session/state");
+  Serial.printf("session/state MQTT subscribe %s\n",
+    topicSessionState >= 0 ? "OK" : "FAILED");
+
+  topicOtaManifest = net.subscribeTopic("ota/manifest");
+  Serial.printf("ota/manifest MQTT subscribe %s\n",
+    topicOtaManifest >= 0 ? "OK" : "FAILED");
+
+  topicOtaChunk = net.subscribeTopic("ota/chunk");
+  Serial.printf("ota/chunk MQTT subscribe %s\n",
+    topicOtaChunk >= 0 ? "OK" : "FAILED");
+
+  topicAuditAck = net.subscribeTopic("audit/ack");
+  Serial.printf("audit/ack MQTT subscribe %s\n",
+    topicAuditAck >= 0 ? "OK" : "FAILED");
+
+  ota.begin(net, FW_VERSION);
+  audit.begin(net);
+
+  // Metrics ride the deferred telemetry lane so an access publish issued
+  // in the same scheduler pass is always next on the wire
+  net.telemetryTopic("metrics/latency");
+  net.telemetryTopic("metrics/tasks");
+
+  // Declare the fields each handler reads so the receive path only
+  // materializes those; config stays unfiltered (arbitrary keys)
+  net.filterTopic(topicAccessResponse, "seq sent_ts_ms response.hasAccess");
+  net.filterTopic(topicKeypadResponse, "response.accessGranted");
+  net.filterTopic(topicKeypadBeep, "data.pinlength");
+  net.filterTopic(topicAccessRevoke, "data.uid");
+  net.filterTopic(topicAuditAck, "data.batch_id");
+
+  // Task table: network and RFID first, housekeeping behind them
+  sched.addTask("net", taskNet, 0, 0);
+  sched.addTask("rfid", taskRfid, 0, 1);
+  sched.addTask("lcd", taskLcd, 10, 2);
+  sched.addTask("session", taskSession, 10, 3);
+  sched.addTask("motion", taskMotion, 50, 4);
+  sched.addTask("ota", taskOta, 100, 5);
+  sched.addTask("audit", taskAudit, 250, 5);
+  sched.addTask("persist", taskPersist, 250, 5);
+  sched.addTask("metrics", taskMetrics, 1000, 5);
+}
+
+// -----------------------------------------------------------------------------
+// Scheduled tasks
+// -----------------------------------------------------------------------------
+
+/** @brief Scheduler task: MQTT and connect state machine processing. */
+void taskNet() {
+  net.loop();
+}
+
+/** @brief Scheduler task: RFID service while idle and display active. */
+void taskRfid() {
+  const uint32_t now = millis();
+
+  // Only allow RFID scans when idle and the display is active
+  if (!session.is(AccessState::Idle) || !isDisplayActive(now)) return;
+
+  // Service a card announced by the RC522 interrupt
+  if (rfidCardDetected) {
+    rfidCardDetected = false;
+    handleRFID();
+  }
+
+  // Periodically re-arm the receiver so the next card fires the IRQ
+  if ((int32_t)(now - nextRfidRearm) >= 0) {
+    activateRfidReception();
+    nextRfidRearm = now + RFID_REARM_MS;
+  }
+}
+
+/** @brief Scheduler task: carry changed LCD cells to the glass. */
+void taskLcd() {
+  lcdBuf.loop();
+}
 
-  Serial.printf("access/keypad_response MQTT subscribe %s\n", 
-    net.subscribe(net.makeTopic("access/keypad_response").c_str()) ? "OK" : "FAILED");
-  
-  Serial.printf("keypad/beep MQTT subscribe %s\n", 
-    net.subscribe(net.makeTopic("keypad/beep").c_str()) ? "OK" : "FAILED");
+/** @brief Scheduler task: session timeout fallbacks. */
+void taskSession() {
+  session.loop();
+}
+
+/** @brief Scheduler task: PIR sampling, backlight, and power-save entry. */
+void taskMotion() {
+  const uint32_t now = millis();
+
+  updateMotionState(now);
+
+  // Long motion-free period: shut the radio and reader down.
+  // Never mid-transfer: power save drops the network the OTA rides on.
+  if (!motionActive && !ota.active() &&
+      (int32_t)(now - (lastMotionMs + cfg.get(cfgIdleSleepMs))) >= 0) {
+    enterPowerSave();
+  }
+}
+
+/** @brief Scheduler task: OTA chunk timeout and resume service. */
+void taskOta() {
+  ota.loop();
+}
+
+/** @brief Scheduler task: audit batch upload and ack-timeout service. */
+void taskAudit() {
+  audit.loop();
+}
+
+/** @brief Scheduler task: debounced flash persistence. */
+void taskPersist() {
+  uidCache.loop();
+  cfg.loop();
+}
+
+/** @brief Scheduler task: latency summary publishing. */
+void taskMetrics() {
+  metrics.loop(net);
 }
 
 /**
  * @brief Arduino main loop.
  *
- * Executes non-blocking system logic:
- * - MQTT client processing
- * - Display timeout handling
- * - Motion-based backlight control
- * - RFID polling when active
+ * Runs the cooperative scheduler, which executes the registered tasks
+ * in priority order with per-task runtime accounting; see setup() for
+ * the task table.
  */
 void loop() {
-  net.loop();     // Process MQTT traffic
-  yield();        // Allow background WiFi tasks
-  
-  const uint32_t now = millis();
-
-  // If a message is currently displayed, wait for timeout
-  if (textshown) {
-    if ((int32_t)(now - showTextUntil) >= 0) {
-      forceLock();            // Reset system when timeout expires
-    }
+  // Power-save mode: only the PIR poll runs; onMotionDetected() wakes us
+  if (powerSaving) {
+    updateMotionState(millis());
+    delay(IDLE_POLL_MS);
     return;
   }
 
-  // Update LCD backlight based on motion sensor
-  updateMotionState(now);
-
-  // Only allow RFID scans when display is active
-  if (isDisplayActive(now)) {
-    handleRFID();
-  }
+  sched.run(net);
 }
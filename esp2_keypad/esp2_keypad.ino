@@ -10,30 +10,44 @@
  * the second stage of the access control system.
  *
  * Hardware components:
- * - 4x4 matrix keypad using the Keypad library
+ * - 4x4 matrix keypad, scanned from a 1 kHz timer1 interrupt
  *
  * Functional responsibilities:
  * - Accepts PIN input from the user
  * - Provides keypress feedback (beeps)
  * - Publishes PIN entry progress and submissions via MQTT
  *
+ * The matrix is sampled at a fixed cadence from the timer ISR with an
+ * integrating debounce; key events are pushed into a small
+ * single-producer/single-consumer queue drained by loop(), so no
+ * keypress is lost while the network stack is busy.
+ *
  * The keypad is only active after successful RFID authentication,
  * which is signaled asynchronously via MQTT.
  */
 
 
 #include <Arduino.h>
-#include <Keypad.h>
 // #include <string.h>
 #include <ArduinoJson.h>
+#include <Hash.h>
 
 #include <WiFiMqttClient.h>
+#include <LatencyMetrics.h>
+#include <ConfigStore.h>
+#include <AccessSession.h>
+#include <CoopScheduler.h>
+#include <OtaUpdater.h>
+#include <AuditLog.h>
 
 // ---------------- Network configuration ----------------
 
 /** @brief WiFi + MQTT client wrapper */
 WifiMqttClient net;
 
+/** @brief Per-stage latency histograms, published on metrics/latency. */
+LatencyMetrics metrics;
+
 /** @brief WiFi SSID */
 constexpr char WIFI_SSID[] = "Mathias2.4";
 /** @brief WiFi password */
@@ -51,6 +65,15 @@ constexpr char MQTT_PASS[] = "potter";
 /** @brief Unique device identifier used in MQTT topics */
 constexpr char DEVICE_ID[] = "door1";
 
+/** @brief Running firmware version, compared against OTA manifests. */
+constexpr char FW_VERSION[] = "1.0.0";
+
+/** @brief Chunked MQTT firmware updater. */
+OtaUpdater ota;
+
+/** @brief Flash-resident audit trail with acknowledged batch upload. */
+AuditLog audit;
+
 // ---------------- Keypad configuration ----------------
 
 /** @brief Number of rows in the keypad matrix */
@@ -96,32 +119,203 @@ byte colPins[COLS] = {2, 14, 12, 13}; /**< D4, D5, D6, D7 */
  * D5=14, D6=12, D7=13, D8=15
  */
 
+// ---------------- Timer-driven matrix scanner ----------------
+
+/**
+ * @brief Samples needed by the integrating debouncer to accept a press.
+ *
+ * One row is scanned per 1 kHz tick, so each key is sampled at 250 Hz;
+ * four consistent samples correspond to ~16 ms of stable contact.
+ */
+constexpr uint8_t DEBOUNCE_SAMPLES = 4;
+
+/** @brief Per-key debounce integrators (0..DEBOUNCE_SAMPLES). */
+volatile uint8_t keyIntegrator[ROWS][COLS] = {};
+
+/** @brief Per-key debounced pressed state. */
+volatile bool keyPressed[ROWS][COLS] = {};
+
+/** @brief Row currently driven by the scanner ISR. */
+volatile uint8_t scanRow = 0;
+
+/**
+ * @brief Size of the key event queue (power of two).
+ */
+constexpr uint8_t KEY_QUEUE_SIZE = 16;
+
+/**
+ * @brief Single-producer/single-consumer key event queue.
+ *
+ * The timer ISR is the only producer and loop() the only consumer,
+ * so head and tail each have a single writer and no locking is needed.
+ */
+volatile char keyQueue[KEY_QUEUE_SIZE];
+
+/** @brief Queue write index (ISR only). */
+volatile uint8_t keyQueueHead = 0;
+
+/** @brief Queue read index (loop() only). */
+volatile uint8_t keyQueueTail = 0;
+
+/**
+ * @brief Timer1 ISR: scans one keypad row per 1 kHz tick.
+ *
+ * Drives the current row low, samples the column inputs, and runs an
+ * integrating debounce per key. A key whose integrator saturates while
+ * released is pushed into the event queue as a press.
+ */
+void IRAM_ATTR onKeypadTick() {
+
+  // Sample the columns for the row driven low by the previous tick
+  const uint8_t row = scanRow;
+
+  for (uint8_t col = 0; col < COLS; col++) {
+    const bool down = (digitalRead(colPins[col]) == LOW);
+
+    uint8_t integ = keyIntegrator[row][col];
+
+    // Integrate towards pressed or released
+    if (down && integ < DEBOUNCE_SAMPLES) {
+      integ++;
+    } else if (!down && integ > 0) {
+      integ--;
+    }
+
+    keyIntegrator[row][col] = integ;
+
+    // Rising edge: integrator saturated while key was released
+    if (integ == DEBOUNCE_SAMPLES && !keyPressed[row][col]) {
+      keyPressed[row][col] = true;
+
+      const uint8_t next = (keyQueueHead + 1) % KEY_QUEUE_SIZE;
+      if (next != keyQueueTail) {     // Drop event only if queue is full
+        keyQueue[keyQueueHead] = keys[row][col];
+        keyQueueHead = next;
+      }
+    }
+    // Falling edge: key fully released
+    else if (integ == 0 && keyPressed[row][col]) {
+      keyPressed[row][col] = false;
+    }
+  }
+
+  // Release this row and drive the next one low for the coming tick
+  pinMode(rowPins[row], INPUT);
+
+  scanRow = (row + 1) % ROWS;
+  pinMode(rowPins[scanRow], OUTPUT);
+  digitalWrite(rowPins[scanRow], LOW);
+}
+
 /**
- * @brief Keypad instance handling scanning and debouncing.
+ * @brief Pops the next key event from the scanner queue.
+ *
+ * @return Key character, or '\0' if the queue is empty.
  */
-Keypad keypad = Keypad(makeKeymap(keys), rowPins, colPins, ROWS, COLS);
+char popKeyEvent() {
+  if (keyQueueTail == keyQueueHead) return '\0';
+
+  const char key = keyQueue[keyQueueTail];
+  keyQueueTail = (keyQueueTail + 1) % KEY_QUEUE_SIZE;
+  return key;
+}
 
 // ---------------- Code handling ----------------
 
-/** @brief Required PIN length */
+/** @brief Default required PIN length (also the buffer capacity). */
 constexpr uint8_t CODE_LENGTH = 4;
 
 /**
  * @brief Input buffer for PIN digits.
  *
- * One extra byte is reserved for the null terminator.
+ * Sized for the maximum PIN length; one extra byte is reserved for the
+ * null terminator. A shorter runtime code_length only uses a prefix.
  */
 char input[CODE_LENGTH + 1] = {0};
 
+/**
+ * @brief Runtime-tunable configuration store.
+ *
+ * Overrides arrive as a retained message on the "config" topic and are
+ * persisted to flash.
+ */
+ConfigStore cfg;
+
+/** @brief Config ID: required PIN length (1..CODE_LENGTH). */
+int8_t cfgCodeLength = -1;
+
 /** @brief Current index into the PIN buffer */
 uint8_t currentIdx = 0;
 
 /**
- * @brief Indicates whether keypad input is currently enabled.
+ * @brief Shared access session state machine.
  *
- * This flag is controlled via MQTT messages from the access controller.
+ * Keypad input is enabled exactly while the session is in PinEntry,
+ * whether that state was reached via this node's own access/response
+ * handler or a peer broadcast on "session/state". This replaces the
+ * old kpEnabled flag, which could disagree with the RFID node's view
+ * of the flow and force the user to restart.
  */
-bool kpEnabled = false;
+AccessSession session;
+
+/** @brief Fallback PIN entry window (ms); peers normally end it first. */
+constexpr uint32_t PIN_TIME_MS = 15000;
+
+/** @brief Fallback unlocked-state duration (ms). */
+constexpr uint32_t UNLOCK_TIME_MS = 5000;
+
+/** @brief Fallback lockout display duration (ms). */
+constexpr uint32_t LOCKOUT_MS = 3000;
+
+/**
+ * @brief Short-lived unlock token issued by the backend.
+ *
+ * Arrives with the granted access/response. On a granted PIN the token
+ * is sent directly to esp3 in a packed frame on "door/unlock", letting
+ * the actuator move without waiting for the backend relay.
+ */
+char unlockToken[33] = "";
+
+/**
+ * @brief Salt for the expected PIN hash, issued with the access response.
+ *
+ * When the backend includes pin_salt and pin_hash in a granted
+ * access/response, the PIN is verified locally on submission instead of
+ * waiting a full broker round trip; only the result goes upward for
+ * audit. Cleared when the keypad window closes.
+ */
+char pinSalt[17] = "";
+
+/** @brief Hex SHA-1 of salt + expected PIN; empty = backend verification. */
+char pinHash[41] = "";
+
+// -----------------------------------------------------------------------------
+// Topic IDs (assigned by WifiMqttClient::subscribeTopic() in setup())
+// -----------------------------------------------------------------------------
+
+/** @brief Topic ID for "access/response". */
+int8_t topicAccessResponse = -1;
+
+/** @brief Topic ID for "access/keypad_response". */
+int8_t topicKeypadResponse = -1;
+
+/** @brief Topic ID for "config" (retained configuration overrides). */
+int8_t topicConfig = -1;
+
+/** @brief Topic ID for "session/state" (peer state-sync broadcasts). */
+int8_t topicSessionState = -1;
+
+/** @brief Topic ID for "ota/manifest" (firmware announcements). */
+int8_t topicOtaManifest = -1;
+
+/** @brief Topic ID for "ota/chunk" (binary firmware chunks). */
+int8_t topicOtaChunk = -1;
+
+/** @brief Topic ID for "audit/ack" (audit batch acknowledgments). */
+int8_t topicAuditAck = -1;
+
+/** @brief Cooperative task scheduler driving loop(). */
+CoopScheduler sched;
 
 // -----------------------------------------------------------------------------
 // MQTT callback
@@ -143,10 +337,27 @@ void callback(char* topic, byte* payload, unsigned int length) {
   // Ignore empty MQTT messages
   if (length == 0) return;
 
+  // Resolve the topic to its registered ID (allocation-free)
+  const int8_t topicId = net.matchTopic(topic);
+  if (topicId < 0) return;
+
+  // Peer state broadcasts are binary; handle them before JSON parsing
+  if (topicId == topicSessionState) {
+    session.applyRemote(payload, length);
+    return;
+  }
+
+  // Firmware chunks are binary as well
+  if (topicId == topicOtaChunk) {
+    ota.handleChunk(payload, length);
+    return;
+  }
+
   StaticJsonDocument<512> doc;
 
-  // Parse JSON payload
-  DeserializationError err = deserializeJson(doc, payload, length);
+  // Filtered in-situ parse: only the fields this topic's handler
+  // declared in setup() are materialized
+  DeserializationError err = net.parseJson(topicId, payload, length, doc);
 
   // Abort on JSON parsing failure
   if (err) {
@@ -158,20 +369,76 @@ void callback(char* topic, byte* payload, unsigned int length) {
   // ---------------------------------------------------------------------------
   // RFID access response: enable or disable keypad
   // ---------------------------------------------------------------------------
-  if (strcmp(topic, net.makeTopic("access/response").c_str()) == 0) {
+  if (topicId == topicAccessResponse) {
+
+    // Open the keypad window only if RFID access was granted
+    const bool hasAccess = doc["response"]["hasAccess"] | false;
+
+    if (!hasAccess) {
+      session.transition(AccessState::Lockout);
+      return;
+    }
+
+    session.transition(AccessState::PinEntry);
+
+    // Hold on to the unlock token issued with a granted response
+    const char* token = doc["response"]["unlock_token"] | (const char*)nullptr;
+    if (token != nullptr) {
+      strncpy(unlockToken, token, sizeof(unlockToken) - 1);
+      unlockToken[sizeof(unlockToken) - 1] = '\0';
+    }
 
-    // Enable keypad only if RFID access was granted
-    kpEnabled = (doc["response"]["hasAccess"] | false)
-      ? true
-      : false;
+    // Salted hash of the expected PIN enables local verification
+    const char* salt = doc["response"]["pin_salt"] | (const char*)nullptr;
+    const char* hash = doc["response"]["pin_hash"] | (const char*)nullptr;
+    if (salt != nullptr && hash != nullptr && strlen(hash) == 40) {
+      strncpy(pinSalt, salt, sizeof(pinSalt) - 1);
+      pinSalt[sizeof(pinSalt) - 1] = '\0';
+      strncpy(pinHash, hash, sizeof(pinHash) - 1);
+      pinHash[sizeof(pinHash) - 1] = '\0';
+    }
   }
   // ---------------------------------------------------------------------------
   // PIN verification response: always disable keypad afterward
   // ---------------------------------------------------------------------------
-  else if (strcmp(topic, net.makeTopic("access/keypad_response").c_str()) == 0) {
+  else if (topicId == topicKeypadResponse) {
+
+    // On a granted PIN, fire the fast-path unlock straight at esp3.
+    // This races the backend's own relay to the actuator and wins
+    // whenever the Node-RED hop is slow; esp3 consumes the token on
+    // first use, so the duplicate grant is harmless.
+    bool granted = doc["response"]["accessGranted"] | false;
+
+    if (granted) {
+      sendUnlockFrame();
+    }
+
+    // Token is single use
+    unlockToken[0] = '\0';
 
-    // Prevent further input until next RFID authorization
-    kpEnabled = false;
+    // The actuator broadcasts Unlocked once it verifies the grant; a
+    // denial ends the keypad window here and on the peers
+    if (!granted) {
+      session.transition(AccessState::Lockout);
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // Retained configuration overrides
+  // ---------------------------------------------------------------------------
+  else if (topicId == topicConfig) {
+    cfg.applyJson(doc);
+  }
+  // ---------------------------------------------------------------------------
+  // Firmware update announcement
+  // ---------------------------------------------------------------------------
+  else if (topicId == topicOtaManifest) {
+    ota.handleManifest(doc);
+  }
+  // ---------------------------------------------------------------------------
+  // Audit batch acknowledgment
+  // ---------------------------------------------------------------------------
+  else if (topicId == topicAuditAck) {
+    audit.handleAck(doc["data"]["batch_id"] | 0);
   }
 }
 
@@ -188,6 +455,36 @@ void callback(char* topic, byte* payload, unsigned int length) {
 void setup() {
   Serial.begin(115200);
 
+  // Register tunable settings, then load persisted overrides. The upper
+  // bound matches the input buffer, which is sized for CODE_LENGTH.
+  cfgCodeLength = cfg.define("code_length", CODE_LENGTH, 1, CODE_LENGTH);
+  cfg.begin();
+
+  // Shared session state machine; keypad input follows PinEntry
+  session.begin(net);
+  session.onChange(handleSessionChange);
+  session.setTimeout(AccessState::RfidPending, LOCKOUT_MS);
+  session.setTimeout(AccessState::PinEntry, PIN_TIME_MS);
+  session.setTimeout(AccessState::Unlocked, UNLOCK_TIME_MS);
+  session.setTimeout(AccessState::Lockout, LOCKOUT_MS);
+
+  // Matrix idle state: rows released, columns pulled up
+  for (uint8_t row = 0; row < ROWS; row++) {
+    pinMode(rowPins[row], INPUT);
+  }
+  for (uint8_t col = 0; col < COLS; col++) {
+    pinMode(colPins[col], INPUT_PULLUP);
+  }
+
+  // Drive the first row low so the first tick has valid samples
+  pinMode(rowPins[0], OUTPUT);
+  digitalWrite(rowPins[0], LOW);
+
+  // Start the 1 kHz scanner: 80 MHz / 16 = 5 MHz, 5000 ticks = 1 ms
+  timer1_attachInterrupt(onKeypadTick);
+  timer1_enable(TIM_DIV16, TIM_EDGE, TIM_LOOP);
+  timer1_write(5000);
+
   net.begin(
     WIFI_SSID,
     WIFI_PASS,
@@ -203,12 +500,65 @@ void setup() {
 
   net.setCallback(callback);
 
-  // Subscribe to access control topics
+  // Subscribe to access control topics (registered for allocation-free dispatch)
+  topicAccessResponse = net.subscribeTopic("access/response");
   Serial.printf("access/response MQTT subscribe %s\n",
-    net.subscribe(net.makeTopic("access/response").c_str()) ? "OK" : "FAILED");
+    topicAccessResponse >= 0 ? "OK" : "FAILED");
 
+  topicKeypadResponse = net.subscribeTopic("access/keypad_response");
   Serial.printf("access/keypad_response MQTT subscribe %s\n",
-    net.subscribe(net.makeTopic("access/keypad_response").c_str()) ? "OK" : "FAILED");
+    topicKeypadResponse >= 0 ? "OK" : "FAILED");
+
+  topicConfig = net.subscribeTopic("config");
+  Serial.printf("config MQTT subscribe %s\n",
+    topicConfig >= 0 ? "OK" : "FAILED");
+
+  topicSessionState = net.subscribeTopic("session/state");
+  Serial.printf("session/state MQTT subscribe %s\n",
+    topicSessionState >= 0 ? "OK" : "FAILED");
+
+  topicOtaManifest = net.subscribeTopic("ota/manifest");
+  Serial.printf("ota/manifest MQTT subscribe %s\n",
+    topicOtaManifest >= 0 ? "OK" : "FAILED");
+
+  topicOtaChunk = net.subscribeTopic("ota/chunk");
+  Serial.printf("ota/chunk MQTT subscribe %s\n",
+    topicOtaChunk >= 0 ? "OK" : "FAILED");
+
+  topicAuditAck = net.subscribeTopic("audit/ack");
+  Serial.printf("audit/ack MQTT subscribe %s\n",
+    topicAuditAck >= 0 ? "OK" : "FAILED");
+
+  ota.begin(net, FW_VERSION);
+  audit.begin(net);
+
+  // Metrics ride the deferred telemetry lane; keypad/result and
+  // keypad/tap stay on the immediate lane (they are the access path)
+  net.telemetryTopic("metrics/latency");
+  net.telemetryTopic("metrics/tasks");
+
+  // Declare the fields each handler reads so the receive path only
+  // materializes those; config stays unfiltered (arbitrary keys)
+  net.filterTopic(topicAccessResponse,
+    "response.hasAccess response.unlock_token "
+    "response.pin_salt response.pin_hash");
+  net.filterTopic(topicKeypadResponse, "response.accessGranted");
+  net.filterTopic(topicAuditAck, "data.batch_id");
+
+  // A fast typist fires several tap events per second; latest-wins
+  // coalescing collapses each burst into one frame carrying the
+  // final pinlength, at the cost of at most 40 ms of feedback delay
+  net.coalesceTopic("keypad/tap",
+                    WifiMqttClient::PublishPolicy::LatestWins, 40);
+
+  // Task table: network and keypad first, housekeeping behind them
+  sched.addTask("net", taskNet, 0, 0);
+  sched.addTask("keypad", taskKeypad, 0, 1);
+  sched.addTask("session", taskSession, 10, 2);
+  sched.addTask("ota", taskOta, 100, 3);
+  sched.addTask("audit", taskAudit, 250, 3);
+  sched.addTask("persist", taskPersist, 250, 3);
+  sched.addTask("metrics", taskMetrics, 1000, 3);
 }
 
 // -----------------------------------------------------------------------------
@@ -226,6 +576,103 @@ void reset_code() {
   currentIdx = 0;                   // Reset write index
 }
 
+/**
+ * @brief Clears keypad state on session boundaries.
+ *
+ * Registered as the AccessSession change handler: entering or leaving
+ * the PinEntry window discards any half-typed code so a stale prefix
+ * never leaks into the next attempt.
+ *
+ * @param from Previous session state.
+ * @param to New session state.
+ * @param remote true if the change came from a peer broadcast.
+ */
+void handleSessionChange(AccessState from, AccessState to, bool remote) {
+  (void)remote;
+
+  if (to == AccessState::PinEntry || from == AccessState::PinEntry) {
+    reset_code();
+  }
+
+  // Hash material only lives as long as the keypad window
+  if (from == AccessState::PinEntry) {
+    pinSalt[0] = '\0';
+    pinHash[0] = '\0';
+  }
+}
+
+/**
+ * @brief Sends the stored unlock token to the actuator as a packed frame.
+ *
+ * Shared by the local verification path and the legacy backend
+ * response path. A no-op when no token is held.
+ */
+void sendUnlockFrame() {
+  if (unlockToken[0] == '\0') return;
+
+  PackedWriter frame;
+  frame.begin(PackedEvent::Unlock, net.deviceChipId());
+  frame.addString(PackedTag::Token, unlockToken);
+
+  net.publishPacked("door/unlock", frame);
+}
+
+/**
+ * @brief Verifies the submitted PIN against the issued salted hash.
+ *
+ * Computes SHA-1(salt + code) and compares it to the expected hex
+ * digest in constant time, so timing cannot leak how many characters
+ * matched. The decision happens entirely on this node; only the result
+ * is published (keypad/result) for the backend audit trail.
+ *
+ * On a match the unlock token goes straight to the actuator; on a
+ * mismatch the session drops into Lockout, which the peers follow.
+ */
+void verifyPinLocally() {
+
+  // SHA-1 over salt + submitted code
+  char material[sizeof(pinSalt) + sizeof(input)];
+  snprintf(material, sizeof(material), "%s%s", pinSalt, input);
+
+  uint8_t digest[20];
+  sha1((const uint8_t*)material, strlen(material), digest);
+
+  // Hex-encode the digest for comparison with the issued hash
+  char hex[41];
+  for (uint8_t i = 0; i < 20; i++) {
+    sprintf(&hex[i * 2], "%02x", digest[i]);
+  }
+
+  // Constant-time comparison over the full digest
+  uint8_t diff = 0;
+  for (uint8_t i = 0; i < 40; i++) {
+    diff |= (uint8_t)hex[i] ^ (uint8_t)pinHash[i];
+  }
+  const bool granted = (diff == 0);
+
+  Serial.println(granted ? "PIN verified locally" : "PIN rejected locally");
+
+  // Flash-resident audit record (attempt outcome, never the code)
+  audit.record(AuditEvent::PinAttempt, granted, nullptr, currentIdx);
+
+  // Publish the result upward for audit (never the code itself)
+  StaticJsonDocument<64> data;
+  data["event"]   = "KP_result";
+  data["granted"] = granted;
+  net.publishJson("keypad/result", data);
+
+  if (granted) {
+    sendUnlockFrame();
+  } else {
+    session.transition(AccessState::Lockout);
+  }
+
+  // Hash material and token are single use
+  pinSalt[0] = '\0';
+  pinHash[0] = '\0';
+  unlockToken[0] = '\0';
+}
+
 /**
  * @brief Publishes keypad tap feedback via MQTT.
  *
@@ -244,34 +691,66 @@ void publishTap() {
 // Main loop
 // -----------------------------------------------------------------------------
 
+// -----------------------------------------------------------------------------
+// Scheduled tasks
+// -----------------------------------------------------------------------------
+
+/** @brief Scheduler task: MQTT and connect state machine processing. */
+void taskNet() {
+  net.loop();
+}
+
+/** @brief Scheduler task: session timeout fallbacks. */
+void taskSession() {
+  session.loop();
+}
+
+/** @brief Scheduler task: OTA chunk timeout and resume service. */
+void taskOta() {
+  ota.loop();
+}
+
+/** @brief Scheduler task: audit batch upload and ack-timeout service. */
+void taskAudit() {
+  audit.loop();
+}
+
+/** @brief Scheduler task: debounced flash persistence. */
+void taskPersist() {
+  cfg.loop();
+}
+
+/** @brief Scheduler task: latency summary publishing. */
+void taskMetrics() {
+  metrics.loop(net);
+}
+
 /**
- * @brief Arduino main loop.
+ * @brief Scheduler task: PIN entry logic.
  *
- * Handles:
- * - MQTT client processing
- * - Keypad scanning
- * - PIN entry logic
- * - PIN submission and reset
+ * Drains the next key event from the scanner queue and handles digit
+ * entry, submission ('#'), and clearing ('*').
  */
-void loop() {
-  net.loop();   // Process MQTT traffic
-  yield();      // Allow background WiFi tasks
+void taskKeypad() {
 
-  // Read keypad state (non-blocking)
-  char key = keypad.getKey();
+  // Drain the next key event from the scanner queue
+  char key = popKeyEvent();
 
-  // Ignore input if no key pressed or keypad is disabled
-  if (key == NO_KEY || !kpEnabled) {
+  // Ignore input outside the PIN entry window
+  if (key == '\0' || !session.is(AccessState::PinEntry)) {
     return;
   }
 
+  // Time the key event -> tap publish interval
+  metrics.stageStart(LatencyStage::KeyToPublish);
+
   // ---------------------------------------------------------------------------
   // Numeric key input
   // ---------------------------------------------------------------------------
   if (key >= '0' && key <= '9') {
 
-    // Only accept input if buffer is not full
-    if (currentIdx < CODE_LENGTH) {
+    // Only accept input if the configured length is not yet reached
+    if (currentIdx < cfg.get(cfgCodeLength)) {
       input[currentIdx++] = key;   // Store digit
       input[currentIdx] = '\0';    // Maintain null-terminated string
 
@@ -285,18 +764,24 @@ void loop() {
   // ---------------------------------------------------------------------------
   else if (key == '#') {
 
-    // Only submit if required PIN length is reached
-    if (currentIdx == CODE_LENGTH) {
-      Serial.print("Submitting code: ");
-      Serial.println(input);
+    // Only submit if the configured PIN length is reached
+    if (currentIdx == cfg.get(cfgCodeLength)) {
+
+      if (pinHash[0] != '\0') {
+        // Hash material on hand: decide locally, no round trip
+        verifyPinLocally();
+      } else {
+        // Legacy backend: send the code up for comparison
+        Serial.print("Submitting code: ");
+        Serial.println(input);
 
-      // Build JSON payload for PIN submission
-      StaticJsonDocument<64> data;
-      data["event"] = "KP_try";
-      data["code"]  = input;
+        StaticJsonDocument<64> data;
+        data["event"] = "KP_try";
+        data["code"]  = input;
 
-      net.publishJson("keypad/submit", data);
-    } 
+        net.publishJson("keypad/submit", data);
+      }
+    }
     else {
       Serial.println("Code too short, resetting.");
     }
@@ -320,4 +805,16 @@ void loop() {
 
   // Any valid keypress is treated as a tap event
   publishTap();
+  metrics.stageEnd(LatencyStage::KeyToPublish);
+}
+
+/**
+ * @brief Arduino main loop.
+ *
+ * Runs the cooperative scheduler, which executes the registered tasks
+ * in priority order with per-task runtime accounting; see setup() for
+ * the task table.
+ */
+void loop() {
+  sched.run(net);
 }
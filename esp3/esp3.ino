@@ -29,12 +29,24 @@
 
 #include <ArduinoJson.h>
 #include <WiFiMqttClient.h>
+#include <LatencyMetrics.h>
+#include <ConfigStore.h>
+#include <AccessSession.h>
+#include <CoopScheduler.h>
+#include <OtaUpdater.h>
+#include <AuditLog.h>
 
 // ---------------- Network configuration ----------------
 
 /** @brief WiFi + MQTT client wrapper */
 WifiMqttClient net;
 
+/** @brief Per-stage latency histograms, published on metrics/latency. */
+LatencyMetrics metrics;
+
+/** @brief Cooperative task scheduler driving loop(). */
+CoopScheduler sched;
+
 /** @brief WiFi SSID */
 constexpr char WIFI_SSID[] = "Mathias2.4";
 /** @brief WiFi password */
@@ -52,6 +64,15 @@ constexpr char MQTT_PASS[] = "potter";
 /** @brief Unique device identifier used in MQTT topics */
 constexpr char DEVICE_ID[] = "door1";
 
+/** @brief Running firmware version, compared against OTA manifests. */
+constexpr char FW_VERSION[] = "1.0.0";
+
+/** @brief Chunked MQTT firmware updater. */
+OtaUpdater ota;
+
+/** @brief Flash-resident audit trail with acknowledged batch upload. */
+AuditLog audit;
+
 // -----------------------------------------------------------------------------
 // Pin configuration | esp3.fzz
 // -----------------------------------------------------------------------------
@@ -73,32 +94,41 @@ constexpr uint8_t SERVO_PIN  = 13;  /**< Servo signal pin */
 // Timing configuration
 // -----------------------------------------------------------------------------
 
-/** @brief Door unlock duration (ms). */
+/** @brief Default door unlock duration (ms). */
 constexpr uint32_t UNLOCK_TIME_MS = 5000;
 
-/** @brief Timestamp (ms) until which the door remains unlocked. */
-uint32_t unlockUntil = 0;
+/** @brief Fallback PIN entry window (ms); the RFID node normally ends it. */
+constexpr uint32_t PIN_TIME_MS = 15000;
+
+/** @brief Fallback lockout duration (ms). */
+constexpr uint32_t LOCKOUT_MS = 3000;
+
+/**
+ * @brief Runtime-tunable configuration store.
+ *
+ * Overrides arrive as a retained message on the "config" topic and are
+ * persisted to flash.
+ */
+ConfigStore cfg;
+
+/** @brief Config ID: door unlock duration. */
+int8_t cfgUnlockTimeMs = -1;
 
 // -----------------------------------------------------------------------------
 // Global state
 // -----------------------------------------------------------------------------
 
-/** @brief Indicates whether the door is currently unlocked. */
-bool unlocked = false;
-
 /**
- * @brief Access result enumeration.
+ * @brief Shared access session state machine.
+ *
+ * Replaces the old unlocked / accessGranted / rfidAccess globals and
+ * the unlockUntil relock timer: the Unlocked state's timeout relocks
+ * the door, and local transitions are broadcast on "session/state" so
+ * the RFID and keypad nodes follow immediately. Remote Unlocked is
+ * rejected on this node: the servo only moves on a locally verified
+ * grant or unlock token.
  */
-enum class AccessResult : uint8_t {
-  Denied,   /**< Access denied */
-  Granted   /**< Access granted */
-};
-
-/** @brief Result of keypad PIN verification. */
-AccessResult accessGranted;
-
-/** @brief Indicates whether RFID access was granted. */
-bool rfidAccess = false;
+AccessSession session;
 
 /** @brief Servo instance controlling the lock mechanism. */
 Servo lock_servo;
@@ -113,155 +143,383 @@ uint8_t servoAngle;
 bool adminServoControl = false;
 
 // -----------------------------------------------------------------------------
-// Buzzer state machine
+// Servo motion engine
+// -----------------------------------------------------------------------------
+
+/*
+ * lock_servo.write(180) used to slam the lock full travel in one step,
+ * and admin mode hammered analogRead() plus a servo write on every loop
+ * iteration. The motion engine replaces both: callers set a target
+ * angle in O(1) and a fixed 20 ms tick (one update per servo refresh
+ * period) ramps the position along a trapezoidal velocity profile.
+ * When the target is reached a seated event is published so the
+ * backend can confirm the lock actually closed.
+ */
+
+/** @brief Servo angle of the locked position (degrees). */
+constexpr uint8_t SERVO_LOCKED_ANGLE = 0;
+
+/** @brief Servo angle of the unlocked position (degrees). */
+constexpr uint8_t SERVO_UNLOCKED_ANGLE = 180;
+
+/** @brief Motion tick interval (ms); matches the servo refresh period. */
+constexpr uint32_t SERVO_TICK_MS = 20;
+
+/** @brief Peak travel speed (degrees per tick). */
+constexpr float SERVO_MAX_SPEED = 9.0f;
+
+/** @brief Acceleration ramp (degrees per tick, per tick). */
+constexpr float SERVO_ACCEL = 1.5f;
+
+/** @brief Pot changes below this (degrees) are ignored in admin mode. */
+constexpr uint8_t POT_DEADBAND_DEG = 3;
+
+/** @brief Commanded target angle (degrees). */
+uint8_t servoTarget = SERVO_LOCKED_ANGLE;
+
+/** @brief Profiled position (degrees, fractional during travel). */
+float servoPos = SERVO_LOCKED_ANGLE;
+
+/** @brief Current profile speed (degrees per tick, signed). */
+float servoSpeed = 0.0f;
+
+/** @brief Indicates whether the engine is still travelling. */
+bool servoMoving = false;
+
+/** @brief Timestamp (ms) of the next motion tick. */
+uint32_t nextServoTick = 0;
+
+/**
+ * @brief Sets the motion target angle.
+ *
+ * O(1): only stores the target; the tick does the work. Safe to call
+ * from the MQTT callback.
+ *
+ * @param angle Target angle in degrees (0..180).
+ */
+void setServoTarget(uint8_t angle) {
+  if (angle > 180) angle = 180;
+
+  if (angle != servoTarget) {
+    servoTarget = angle;
+    servoMoving = true;
+  }
+}
+
+/**
+ * @brief Advances the trapezoidal motion profile one tick when due.
+ *
+ * Accelerates toward the target, cruises at SERVO_MAX_SPEED, and
+ * ramps down so the remaining distance can always be absorbed by the
+ * deceleration phase. Publishes a seated event on arrival.
+ */
+void servoLoop() {
+  if (!servoMoving) return;
+
+  const uint32_t now = millis();
+  if ((int32_t)(now - nextServoTick) < 0) return;
+  nextServoTick = now + SERVO_TICK_MS;
+
+  const float remaining = (float)servoTarget - servoPos;
+  const float direction = (remaining >= 0.0f) ? 1.0f : -1.0f;
+  const float distance  = remaining * direction;
+
+  // Arrived: snap onto the target and report the lock as seated
+  if (distance < 1.0f) {
+    servoPos   = servoTarget;
+    servoSpeed = 0.0f;
+    servoMoving = false;
+    lock_servo.write(servoTarget);
+
+    // Close the command -> seated interval for unlock travel
+    if (servoTarget == SERVO_UNLOCKED_ANGLE) {
+      metrics.stageEnd(LatencyStage::CommandToServo);
+    }
+
+    StaticJsonDocument<64> data;
+    data["event"] = "servo_seated";
+    data["angle"] = servoTarget;
+    net.publishJson("door/servo_state", data);
+    return;
+  }
+
+  // Decelerate when the remaining distance is what the ramp needs,
+  // otherwise accelerate up to the speed limit
+  const float brakingDistance =
+    (servoSpeed * servoSpeed) / (2.0f * SERVO_ACCEL);
+
+  if (distance <= brakingDistance || servoSpeed * direction < 0.0f) {
+    servoSpeed -= direction * SERVO_ACCEL;
+  } else {
+    servoSpeed += direction * SERVO_ACCEL;
+    if (servoSpeed > SERVO_MAX_SPEED)  servoSpeed = SERVO_MAX_SPEED;
+    if (servoSpeed < -SERVO_MAX_SPEED) servoSpeed = -SERVO_MAX_SPEED;
+  }
+
+  // Never stall short of the target
+  if (servoSpeed * direction < SERVO_ACCEL * 0.5f) {
+    servoSpeed = direction * SERVO_ACCEL * 0.5f;
+  }
+
+  servoPos += servoSpeed;
+
+  // Clamp overshoot from the final partial step
+  if ((direction > 0.0f && servoPos > servoTarget) ||
+      (direction < 0.0f && servoPos < servoTarget)) {
+    servoPos = servoTarget;
+  }
+
+  lock_servo.write((int)(servoPos + 0.5f));
+}
+
+// -----------------------------------------------------------------------------
+// Topic IDs (assigned by WifiMqttClient::subscribeTopic() in setup())
+// -----------------------------------------------------------------------------
+
+/** @brief Topic ID for "access/response". */
+int8_t topicAccessResponse = -1;
+
+/** @brief Topic ID for "access/keypad_response". */
+int8_t topicKeypadResponse = -1;
+
+/** @brief Topic ID for "keypad/beep". */
+int8_t topicKeypadBeep = -1;
+
+/** @brief Topic ID for "admin/servo_control". */
+int8_t topicAdminServo = -1;
+
+/** @brief Topic ID for "door/unlock" (node-to-node fast path). */
+int8_t topicDoorUnlock = -1;
+
+/** @brief Topic ID for "config" (retained configuration overrides). */
+int8_t topicConfig = -1;
+
+/** @brief Topic ID for "session/state" (peer state-sync broadcasts). */
+int8_t topicSessionState = -1;
+
+/** @brief Topic ID for "ota/manifest" (firmware announcements). */
+int8_t topicOtaManifest = -1;
+
+/** @brief Topic ID for "ota/chunk" (binary firmware chunks). */
+int8_t topicOtaChunk = -1;
+
+/** @brief Topic ID for "audit/ack" (audit batch acknowledgments). */
+int8_t topicAuditAck = -1;
+
+// -----------------------------------------------------------------------------
+// Unlock fast path
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Short-lived unlock token issued by the backend.
+ *
+ * Delivered with a granted access/response; a node that later publishes
+ * a packed frame on "door/unlock" carrying this token can unlock the
+ * door without waiting for another backend round trip. Single use.
+ */
+char unlockToken[33] = "";
+
+/** @brief Timestamp (ms) when the stored unlock token expires. */
+uint32_t unlockTokenUntil = 0;
+
+/** @brief Validity window (ms) of an issued unlock token. */
+constexpr uint32_t UNLOCK_TOKEN_TTL_MS = 30000;
+
+// -----------------------------------------------------------------------------
+// Buzzer engine (timer1-driven, flash-resident patterns)
 // -----------------------------------------------------------------------------
 
 /*
  * Timing arrays define alternating ON/OFF durations in milliseconds.
  * Even indices (LEFT): buzzer ON durations
  * Odd indices (RIGHT):  buzzer OFF durations
+ *
+ * Pattern edges are produced by a timer1 one-shot interrupt, so the
+ * timing is independent of how long net.loop() blocks. The tables live
+ * in PROGMEM; playSound() stages the active pattern into a small RAM
+ * buffer so the ISR never reads flash (flash reads in interrupt context
+ * crash while LittleFS is writing).
  */
 
 /** @brief Denied access: single long beep. Extra long to scare */
-const unsigned int deniedTimings[] = {
+const uint16_t deniedTimings[] PROGMEM = {
   2000
 };
 
 /** @brief Lock sound: long-long-long pattern. */
-const unsigned int lockTimings[] = {
+const uint16_t lockTimings[] PROGMEM = {
   250, 120,
   250, 120,
   250
 };
 
 /** @brief Unlock sound: short-short pattern. */
-const unsigned int unlockTimings[] = {
+const uint16_t unlockTimings[] PROGMEM = {
   125, 120,
   125
 };
 
 /** @brief Keypad tap sound: short beep. */
-const unsigned int beepTimings[] = {
+const uint16_t beepTimings[] PROGMEM = {
   125
 };
 
 /**
- * @brief Buzzer state enumeration.
+ * @brief Buzzer sounds, in pattern table order.
  */
-enum BuzzerState {
-  BUZZER_IDLE, /**< No sound playing */
-  BUZZER_ON,   /**< Buzzer currently active */
-  BUZZER_OFF   /**< Silent gap between beeps */
+enum class BuzzerSound : uint8_t {
+  Tap = 0,  /**< Keypad tap feedback */
+  Unlock,   /**< Door unlocking */
+  Lock,     /**< Door relocking */
+  Denied,   /**< Access denied alarm */
+  None      /**< No sound (pending-slot sentinel) */
 };
 
 /**
  * @brief Describes a buzzer sound pattern.
  */
 struct BuzzerPattern {
-  const unsigned int* timings; /**< Pointer to timing array */
-  uint8_t length;              /**< Number of timing entries */
+  const uint16_t* timings; /**< Flash-resident timing array */
+  uint8_t length;          /**< Number of timing entries */
+  uint8_t priority;        /**< Higher values preempt lower ones */
 };
 
-/** @brief Current buzzer state. */
-BuzzerState buzzerState = BUZZER_IDLE;
+/** @brief Compile-time pattern descriptor table, indexed by BuzzerSound. */
+const BuzzerPattern buzzerPatterns[] PROGMEM = {
+  { beepTimings,   1, 1 },  /* Tap */
+  { unlockTimings, 3, 2 },  /* Unlock */
+  { lockTimings,   5, 2 },  /* Lock */
+  { deniedTimings, 1, 3 },  /* Denied */
+};
 
-/** @brief Currently active buzzer pattern. */
-BuzzerPattern currentPattern = {nullptr, 0};
+/** @brief Longest supported pattern (timing entries). */
+constexpr uint8_t BUZZER_MAX_STEPS = 8;
 
-/** @brief Index into the timing array. */
-uint8_t stepIndex = 0;
+/** @brief RAM staging copy of the active pattern (ISR-readable). */
+volatile uint16_t activeTimings[BUZZER_MAX_STEPS];
 
-/** @brief Timestamp of last buzzer state change. */
-unsigned long lastChange = 0;
+/** @brief Number of steps in the active pattern; 0 when idle. */
+volatile uint8_t buzzerLength = 0;
+
+/** @brief Current step index within the active pattern. */
+volatile uint8_t buzzerStep = 0;
+
+/** @brief Priority of the active pattern; 0 when idle. */
+volatile uint8_t buzzerPriority = 0;
+
+/** @brief Current buzzer output level. */
+volatile bool buzzerOn = false;
+
+/** @brief Sound waiting for the active pattern to finish (latest wins). */
+volatile BuzzerSound pendingSound = BuzzerSound::None;
 
 /**
- * @brief Starts playing a buzzer pattern.
+ * @brief Converts a step duration to timer1 ticks.
  *
- * @param timings Pointer to timing array.
- * @param length Number of elements in the timing array.
+ * timer1 runs at 80 MHz / 256 = 312.5 kHz, so 2 s still fits the
+ * 23-bit counter with room to spare.
+ *
+ * @param ms Duration in milliseconds.
+ * @return Tick count for timer1_write().
  */
-void playPattern(const unsigned int* timings, uint8_t length) {
-
-  // Prevent overlapping sound patterns
-  if (buzzerState != BUZZER_IDLE) return;
+static inline uint32_t buzzerTicks(uint16_t ms) {
+  return (uint32_t)ms * 625UL / 2UL;
+}
 
-  currentPattern.timings = timings;
-  currentPattern.length  = length;
+/**
+ * @brief timer1 one-shot ISR: advances the active pattern one edge.
+ *
+ * Toggles the buzzer pin and re-arms the timer for the next step; at
+ * the end of the pattern the pin is forced low and the engine goes
+ * idle. Only RAM is touched here.
+ */
+void IRAM_ATTR onBuzzerEdge() {
+  buzzerStep++;
 
-  stepIndex   = 0;
-  buzzerState = BUZZER_ON;
-  lastChange  = millis();
+  // End of pattern: silence and release the engine
+  if (buzzerStep >= buzzerLength) {
+    digitalWrite(BUZZER_PIN, LOW);
+    buzzerOn = false;
+    buzzerLength = 0;
+    buzzerPriority = 0;
+    return;
+  }
 
-  digitalWrite(BUZZER_PIN, HIGH);  // Start with buzzer ON
+  // Toggle output and schedule the next edge
+  buzzerOn = !buzzerOn;
+  digitalWrite(BUZZER_PIN, buzzerOn ? HIGH : LOW);
+  timer1_write(buzzerTicks(activeTimings[buzzerStep]));
 }
 
 /**
- * @brief Advances the buzzer state machine.
+ * @brief Starts a sound, honoring pattern priorities.
  *
- * Must be called frequently from the main loop.
+ * A sound of equal or higher priority preempts the active pattern; a
+ * lower-priority sound is parked in the pending slot and played when
+ * the current pattern finishes, so a tap beep can no longer cancel an
+ * in-progress denied alarm.
+ *
+ * @param sound Sound to play.
  */
-void updateBuzzer() {
-  if (buzzerState == BUZZER_IDLE) return;
-
-  unsigned long now = millis();
+void playSound(BuzzerSound sound) {
 
-  // Wait until current timing interval expires
-  if (now - lastChange < currentPattern.timings[stepIndex]) return;
+  // Fetch the descriptor from flash
+  BuzzerPattern def;
+  memcpy_P(&def, &buzzerPatterns[(uint8_t)sound], sizeof(def));
 
-  lastChange = now;
-  stepIndex++;
+  if (def.length > BUZZER_MAX_STEPS) return;
 
-  // End of pattern reached
-  if (stepIndex >= currentPattern.length) {
-    digitalWrite(BUZZER_PIN, LOW);
-    buzzerState = BUZZER_IDLE;
+  // Busy with something more important: park the request instead
+  if (buzzerLength != 0 && def.priority < buzzerPriority) {
+    pendingSound = sound;
     return;
   }
 
-  // Toggle buzzer state
-  if (buzzerState == BUZZER_ON) {
-    digitalWrite(BUZZER_PIN, LOW);
-    buzzerState = BUZZER_OFF;
-  } else {
-    digitalWrite(BUZZER_PIN, HIGH);
-    buzzerState = BUZZER_ON;
+  // Stage the pattern into RAM for the ISR
+  for (uint8_t i = 0; i < def.length; i++) {
+    activeTimings[i] = pgm_read_word(&def.timings[i]);
   }
+
+  buzzerStep     = 0;
+  buzzerLength   = def.length;
+  buzzerPriority = def.priority;
+  buzzerOn       = true;
+
+  digitalWrite(BUZZER_PIN, HIGH);  // Start with buzzer ON
+  timer1_write(buzzerTicks(activeTimings[0]));
 }
 
 /**
- * @brief Immediately stops any active buzzer sound.
+ * @brief Starts a parked sound once the engine is idle.
+ *
+ * Called from loop(); the ISR itself never starts patterns.
  */
-void stopBuzzer() {
-  buzzerState = BUZZER_IDLE;
-  digitalWrite(BUZZER_PIN, LOW);
+void buzzerLoop() {
+  if (buzzerLength != 0 || pendingSound == BuzzerSound::None) return;
+
+  const BuzzerSound next = pendingSound;
+  pendingSound = BuzzerSound::None;
+  playSound(next);
 }
 
 /** @brief Plays lock sound pattern. */
 void playLockSound() {
-  stopBuzzer();
-  playPattern(lockTimings,
-              sizeof(lockTimings) / sizeof(lockTimings[0]));
+  playSound(BuzzerSound::Lock);
 }
 
 /** @brief Plays unlock sound pattern. */
 void playUnlockSound() {
-  stopBuzzer();
-  playPattern(unlockTimings,
-              sizeof(unlockTimings) / sizeof(unlockTimings[0]));
+  playSound(BuzzerSound::Unlock);
 }
 
 /** @brief Plays denied-access sound pattern. */
 void playDeniedSound() {
-  stopBuzzer();
-  playPattern(deniedTimings,
-              sizeof(deniedTimings) / sizeof(deniedTimings[0]));
+  playSound(BuzzerSound::Denied);
 }
 
 /** @brief Plays keypad tap sound. */
 void playTapSound() {
-  stopBuzzer();
-  playPattern(beepTimings,
-              sizeof(beepTimings) / sizeof(beepTimings[0]));
+  playSound(BuzzerSound::Tap);
 }
 
 // -----------------------------------------------------------------------------
@@ -269,25 +527,115 @@ void playTapSound() {
 // -----------------------------------------------------------------------------
 
 /**
- * @brief Forces the system into a locked idle state.
+ * @brief Drives LEDs and servo to the locked position.
  *
- * - Resets access state
- * - Sets LEDs to "locked"
- * - Moves servo to closed position if needed
+ * Shared by the session change handler and the admin override exit.
  */
 static void forceLock() {
-  accessGranted = AccessResult::Denied;
-  unlocked = false;
-
   digitalWrite(RED_PIN, HIGH);
   digitalWrite(GREEN_PIN, LOW);
 
   if (servoOpen) {
-    lock_servo.write(0);   // Move servo to locked position
+    setServoTarget(SERVO_LOCKED_ANGLE);  // Profile back to locked
     servoOpen = false;
   }
 }
 
+/**
+ * @brief Drives LEDs and servo to the unlocked position.
+ *
+ * Only called from the session change handler on entering Unlocked;
+ * the relock is the Unlocked state's timeout falling back to Idle.
+ */
+static void unlockDoor() {
+  Serial.println("Unlocking door");
+  playUnlockSound();
+
+  // The interval ends when the motion engine reports the servo seated
+  metrics.stageStart(LatencyStage::CommandToServo);
+  setServoTarget(SERVO_UNLOCKED_ANGLE);
+  servoOpen = true;
+
+  digitalWrite(GREEN_PIN, HIGH);
+  digitalWrite(RED_PIN, LOW);
+}
+
+/**
+ * @brief Actuates outputs on every session state change.
+ *
+ * Registered as the AccessSession change handler; all servo, LED, and
+ * denial-alarm side effects live here so local events and peer
+ * broadcasts behave identically.
+ *
+ * @param from Previous session state.
+ * @param to New session state.
+ * @param remote true if the change came from a peer broadcast.
+ */
+void handleSessionChange(AccessState from, AccessState to, bool remote) {
+  (void)remote;
+
+  switch (to) {
+    case AccessState::Unlocked:
+      unlockDoor();
+      audit.record(AuditEvent::Unlock, true);
+      break;
+
+    case AccessState::Lockout:
+      Serial.println("Access Denied");
+      playDeniedSound();
+      forceLock();
+      audit.record(AuditEvent::Lockout, false);
+      break;
+
+    case AccessState::Idle:
+      if (from == AccessState::Unlocked) {
+        Serial.println("Locking door");
+        playLockSound();
+      }
+      forceLock();
+      break;
+
+    default:
+      break;
+  }
+}
+
+/**
+ * @brief Handles a packed unlock frame on the fast-path topic.
+ *
+ * Verifies the carried token against the one issued with the last
+ * granted access response; a match unlocks the door without a
+ * backend round trip. Tokens are single use and expire after
+ * UNLOCK_TOKEN_TTL_MS.
+ *
+ * @param payload Raw payload bytes.
+ * @param length Payload length.
+ */
+void handleUnlockFrame(const uint8_t* payload, unsigned int length) {
+
+  PackedReader frame(payload, length);
+  if (!frame.valid() || frame.event() != PackedEvent::Unlock) return;
+
+  // No token issued, or the issued token has expired
+  if (unlockToken[0] == '\0' ||
+      (int32_t)(millis() - unlockTokenUntil) >= 0) {
+    Serial.println("Fast-path unlock rejected: no valid token");
+    return;
+  }
+
+  char carried[33];
+  frame.readString(PackedTag::Token, carried, sizeof(carried));
+
+  if (strcmp(carried, unlockToken) != 0) {
+    Serial.println("Fast-path unlock rejected: token mismatch");
+    return;
+  }
+
+  // Token verified: consume it and actuate via the session
+  unlockToken[0] = '\0';
+  session.transition(AccessState::Unlocked);
+}
+
 // -----------------------------------------------------------------------------
 // MQTT callback
 // -----------------------------------------------------------------------------
@@ -296,6 +644,7 @@ static void forceLock() {
  * @brief MQTT message callback handler.
  *
  * Handles:
+ * - Token-verified fast-path unlock frames
  * - Keypad access responses (unlock / deny)
  * - RFID access denials
  * - Keypad tap beep feedback
@@ -310,8 +659,35 @@ void callback(char* topic, byte* payload, unsigned int length) {
   // Ignore empty MQTT messages
   if (length == 0) return;
 
+  // Resolve the topic to its registered ID (allocation-free)
+  const int8_t topicId = net.matchTopic(topic);
+  if (topicId < 0) return;
+
+  // Fast-path unlock frames are binary; handle them before JSON parsing
+  if (topicId == topicDoorUnlock) {
+    if (adminServoControl) return;
+    handleUnlockFrame(payload, length);
+    return;
+  }
+
+  // Peer state broadcasts are binary as well
+  if (topicId == topicSessionState) {
+    if (adminServoControl) return;
+    session.applyRemote(payload, length);
+    return;
+  }
+
+  // Firmware chunks are binary too, and flow even in admin mode
+  if (topicId == topicOtaChunk) {
+    ota.handleChunk(payload, length);
+    return;
+  }
+
   StaticJsonDocument<512> doc;
-  DeserializationError err = deserializeJson(doc, payload, length);
+
+  // Filtered in-situ parse: only the fields this topic's handler
+  // declared in setup() are materialized
+  DeserializationError err = net.parseJson(topicId, payload, length, doc);
 
   // Abort if JSON parsing fails
   if (err) {
@@ -323,60 +699,63 @@ void callback(char* topic, byte* payload, unsigned int length) {
   // ---------------------------------------------------------------------------
   // Keypad PIN verification response
   // ---------------------------------------------------------------------------
-  if (strcmp(topic, net.makeTopic("access/keypad_response").c_str()) == 0) {
+  if (topicId == topicKeypadResponse) {
 
     // Ignore keypad responses during admin servo control
     if (adminServoControl) return;
 
-    accessGranted = (doc["response"]["accessGranted"] | false)
-      ? AccessResult::Granted
-      : AccessResult::Denied;
+    // Drop QoS 1 redeliveries so a duplicate cannot re-trigger the lock
+    uint32_t seq = doc["seq"] | 0;
+    if (seq != 0 && net.seenRecently(seq)) return;
 
-    if (accessGranted != AccessResult::Granted) {
-      Serial.println("Access Denied");
-      playDeniedSound();
-      forceLock();
+    const bool granted = doc["response"]["accessGranted"] | false;
+
+    if (!granted) {
+      session.transition(AccessState::Lockout);
       return;
     }
 
-    // Access granted: unlock door
-    Serial.println("Unlocking door");
-    playUnlockSound();
-
-    lock_servo.write(180);   // Move servo to unlocked position
-    servoOpen = true;
-
-    digitalWrite(GREEN_PIN, HIGH);
-    digitalWrite(RED_PIN, LOW);
-
-    unlocked = true;
-    unlockUntil = millis() + UNLOCK_TIME_MS;
+    // Access granted: unlock. If the token fast path already moved the
+    // session to Unlocked, this transition is a no-op.
+    session.transition(AccessState::Unlocked);
   }
 
   // ---------------------------------------------------------------------------
   // RFID access response (only react to denial)
   // ---------------------------------------------------------------------------
-  else if (strcmp(topic, net.makeTopic("access/response").c_str()) == 0) {
+  else if (topicId == topicAccessResponse) {
 
-    rfidAccess = (doc["response"]["hasAccess"] | false)
-      ? true
-      : false;
+    // Drop QoS 1 redeliveries to avoid replaying the denied alarm
+    uint32_t seq = doc["seq"] | 0;
+    if (seq != 0 && net.seenRecently(seq)) return;
 
-    if (!rfidAccess) {
-      Serial.println("Access Denied");
-      playDeniedSound();
-      forceLock();
+    const bool hasAccess = doc["response"]["hasAccess"] | false;
+
+    if (!hasAccess) {
+      session.transition(AccessState::Lockout);
       return;
     }
+
+    // RFID accepted: the keypad window is open
+    session.transition(AccessState::PinEntry);
+
+    // Store the unlock token issued with the granted response so a
+    // later fast-path frame can be verified locally
+    const char* token = doc["response"]["unlock_token"] | (const char*)nullptr;
+    if (token != nullptr) {
+      strncpy(unlockToken, token, sizeof(unlockToken) - 1);
+      unlockToken[sizeof(unlockToken) - 1] = '\0';
+      unlockTokenUntil = millis() + UNLOCK_TOKEN_TTL_MS;
+    }
   }
 
   // ---------------------------------------------------------------------------
   // Keypad tap feedback
   // ---------------------------------------------------------------------------
-  else if (strcmp(topic, net.makeTopic("keypad/beep").c_str()) == 0) {
+  else if (topicId == topicKeypadBeep) {
 
-    // Only beep if RFID access is valid
-    if (!rfidAccess) return;
+    // Only beep during the keypad window
+    if (!session.is(AccessState::PinEntry)) return;
 
     playTapSound();
   }
@@ -384,7 +763,7 @@ void callback(char* topic, byte* payload, unsigned int length) {
   // ---------------------------------------------------------------------------
   // Admin servo control enable/disable
   // ---------------------------------------------------------------------------
-  else if (strcmp(topic, net.makeTopic("admin/servo_control").c_str()) == 0) {
+  else if (topicId == topicAdminServo) {
 
     adminServoControl = (doc["data"]["adminServoControl"] | false)
       ? true
@@ -392,12 +771,35 @@ void callback(char* topic, byte* payload, unsigned int length) {
 
     if (!adminServoControl) {
       Serial.println("Admin servo control disabled");
-      forceLock();  // Reset servo to locked state
+      forceLock();                           // Reset servo to locked state
+      session.transition(AccessState::Idle); // And resynchronize the peers
       return;
     }
 
     Serial.println("Admin servo control enabled");
   }
+
+  // ---------------------------------------------------------------------------
+  // Retained configuration overrides
+  // ---------------------------------------------------------------------------
+  else if (topicId == topicConfig) {
+    if (cfg.applyJson(doc) > 0) {
+      // Push the (possibly overridden) relock timing into the session
+      session.setTimeout(AccessState::Unlocked, cfg.get(cfgUnlockTimeMs));
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // Firmware update announcement
+  // ---------------------------------------------------------------------------
+  else if (topicId == topicOtaManifest) {
+    ota.handleManifest(doc);
+  }
+  // ---------------------------------------------------------------------------
+  // Audit batch acknowledgment
+  // ---------------------------------------------------------------------------
+  else if (topicId == topicAuditAck) {
+    audit.handleAck(doc["data"]["batch_id"] | 0);
+  }
 }
 
 // -----------------------------------------------------------------------------
@@ -426,9 +828,28 @@ void setup() {
 
   servoAngle = 0;
 
+  // Buzzer pattern edges come from a timer1 one-shot, so they stay
+  // clean no matter how long a loop() pass takes
+  timer1_attachInterrupt(onBuzzerEdge);
+  timer1_enable(TIM_DIV256, TIM_EDGE, TIM_SINGLE);
+
   delay(100);
   Serial.begin(115200);
 
+  // Register tunable timings, then load persisted overrides
+  cfgUnlockTimeMs = cfg.define("unlock_time_ms", UNLOCK_TIME_MS, 1000, 60000);
+  cfg.begin();
+
+  // Shared session state machine; all actuation lives in the handler.
+  // Remote Unlocked is rejected: the door only moves on a verified path.
+  session.begin(net);
+  session.onChange(handleSessionChange);
+  session.acceptRemote(AccessState::Unlocked, false);
+  session.setTimeout(AccessState::RfidPending, LOCKOUT_MS);
+  session.setTimeout(AccessState::PinEntry, PIN_TIME_MS);
+  session.setTimeout(AccessState::Unlocked, cfg.get(cfgUnlockTimeMs));
+  session.setTimeout(AccessState::Lockout, LOCKOUT_MS);
+
   net.begin(
     WIFI_SSID,
     WIFI_PASS,
@@ -444,61 +865,152 @@ void setup() {
 
   net.setCallback(callback);
 
-  // Subscribe to required MQTT topics
+  // Subscribe to required MQTT topics (registered for allocation-free dispatch)
+  topicAccessResponse = net.subscribeTopic("access/response");
   Serial.printf("access/response MQTT subscribe %s\n",
-    net.subscribe(net.makeTopic("access/response").c_str()) ? "OK" : "FAILED");
+    topicAccessResponse >= 0 ? "OK" : "FAILED");
 
+  topicKeypadResponse = net.subscribeTopic("access/keypad_response");
   Serial.printf("access/keypad_response MQTT subscribe %s\n",
-    net.subscribe(net.makeTopic("access/keypad_response").c_str()) ? "OK" : "FAILED");
+    topicKeypadResponse >= 0 ? "OK" : "FAILED");
 
+  topicKeypadBeep = net.subscribeTopic("keypad/beep");
   Serial.printf("keypad/beep MQTT subscribe %s\n",
-    net.subscribe(net.makeTopic("keypad/beep").c_str()) ? "OK" : "FAILED");
+    topicKeypadBeep >= 0 ? "OK" : "FAILED");
 
+  topicAdminServo = net.subscribeTopic("admin/servo_control");
   Serial.printf("admin/servo_control MQTT subscribe %s\n",
-    net.subscribe(net.makeTopic("admin/servo_control").c_str()) ? "OK" : "FAILED");
+    topicAdminServo >= 0 ? "OK" : "FAILED");
+
+  topicDoorUnlock = net.subscribeTopic("door/unlock");
+  Serial.printf("door/unlock MQTT subscribe %s\n",
+    topicDoorUnlock >= 0 ? "OK" : "FAILED");
+
+  topicConfig = net.subscribeTopic("config");
+  Serial.printf("config MQTT subscribe %s\n",
+    topicConfig >= 0 ? "OK" : "FAILED");
+
+  topicSessionState = net.subscribeTopic("session/state");
+  Serial.printf("session/state MQTT subscribe %s\n",
+    topicSessionState >= 0 ? "OK" : "FAILED");
+
+  topicOtaManifest = net.subscribeTopic("ota/manifest");
+  Serial.printf("ota/manifest MQTT subscribe %s\n",
+    topicOtaManifest >= 0 ? "OK" : "FAILED");
+
+  topicOtaChunk = net.subscribeTopic("ota/chunk");
+  Serial.printf("ota/chunk MQTT subscribe %s\n",
+    topicOtaChunk >= 0 ? "OK" : "FAILED");
+
+  topicAuditAck = net.subscribeTopic("audit/ack");
+  Serial.printf("audit/ack MQTT subscribe %s\n",
+    topicAuditAck >= 0 ? "OK" : "FAILED");
+
+  ota.begin(net, FW_VERSION);
+  audit.begin(net);
+
+  // Metrics ride the deferred telemetry lane; door/servo_state stays
+  // on the immediate lane so the peers see actuation without delay
+  net.telemetryTopic("metrics/latency");
+  net.telemetryTopic("metrics/tasks");
+
+  // Declare the fields each handler reads so the receive path only
+  // materializes those; config stays unfiltered (arbitrary keys) and
+  // keypad/beep carries no fields this node reads
+  net.filterTopic(topicAccessResponse,
+    "seq response.hasAccess response.unlock_token");
+  net.filterTopic(topicKeypadResponse, "seq response.accessGranted");
+  net.filterTopic(topicAdminServo, "data.adminServoControl");
+  net.filterTopic(topicAuditAck, "data.batch_id");
+
+  // Task table: network first, actuation next, housekeeping behind
+  sched.addTask("net", taskNet, 0, 0);
+  sched.addTask("servo", taskServo, 0, 1);
+  sched.addTask("buzzer", taskBuzzer, 0, 2);
+  sched.addTask("admin_pot", taskAdminPot, SERVO_TICK_MS, 3);
+  sched.addTask("session", taskSession, 10, 4);
+  sched.addTask("ota", taskOta, 100, 5);
+  sched.addTask("audit", taskAudit, 250, 5);
+  sched.addTask("persist", taskPersist, 250, 5);
+  sched.addTask("metrics", taskMetrics, 1000, 5);
 }
 
 // -----------------------------------------------------------------------------
 // Main loop
 // -----------------------------------------------------------------------------
 
+// -----------------------------------------------------------------------------
+// Scheduled tasks
+// -----------------------------------------------------------------------------
+
+/** @brief Scheduler task: MQTT and connect state machine processing. */
+void taskNet() {
+  net.loop();
+}
+
 /**
- * @brief Arduino main loop.
+ * @brief Scheduler task: admin pot sampling with deadband filtering.
  *
- * Handles:
- * - MQTT processing
- * - Buzzer state machine updates
- * - Servo admin override mode
- * - Automatic relocking after timeout
+ * Only active in admin servo control mode.
  */
-void loop() {
-  net.loop();
-  yield();
+void taskAdminPot() {
+  if (!adminServoControl) return;
+
+  uint8_t angle = (int)(analogRead(POT_PIN) / 1023.0f * 180.0f);
+  angle = constrain(angle, 0, 180);
+
+  // Deadband: ignore pot jitter below the threshold
+  const int16_t delta = (int16_t)angle - (int16_t)servoAngle;
+  if (delta >= POT_DEADBAND_DEG || delta <= -POT_DEADBAND_DEG ||
+      angle == 0 || angle == 180) {
+    servoAngle = angle;
+    setServoTarget(servoAngle);
+  }
+}
 
-  // Advance buzzer state machine
-  updateBuzzer();
+/** @brief Scheduler task: servo motion profile ticks. */
+void taskServo() {
+  servoLoop();
+}
 
-  // ---------------------------------------------------------------------------
-  // Admin servo control mode
-  // ---------------------------------------------------------------------------
-  if (adminServoControl) {
+/** @brief Scheduler task: start parked buzzer sounds. */
+void taskBuzzer() {
+  buzzerLoop();
+}
 
-    // Map potentiometer value to servo angle
-    servoAngle = (int)(analogRead(POT_PIN) / 1023.0f * 180.0f);
-    servoAngle = constrain(servoAngle, 0, 180);
+/** @brief Scheduler task: session timeout fallbacks (relock, ...). */
+void taskSession() {
+  if (adminServoControl) return;  // Admin mode suspends the flow
+  session.loop();
+}
 
-    lock_servo.write(servoAngle);
-    return;
-  }
+/** @brief Scheduler task: OTA chunk timeout and resume service. */
+void taskOta() {
+  ota.loop();
+}
 
-  // ---------------------------------------------------------------------------
-  // Automatic relock after unlock timeout
-  // ---------------------------------------------------------------------------
-  const uint32_t now = millis();
+/** @brief Scheduler task: audit batch upload and ack-timeout service. */
+void taskAudit() {
+  audit.loop();
+}
 
-  if (unlocked && (int32_t)(now - unlockUntil) >= 0) {
-    Serial.println("Locking door");
-    playLockSound();
-    forceLock();
-  }
+/** @brief Scheduler task: debounced flash persistence. */
+void taskPersist() {
+  cfg.loop();
+}
+
+/** @brief Scheduler task: latency summary publishing. */
+void taskMetrics() {
+  metrics.loop(net);
+}
+
+/**
+ * @brief Arduino main loop.
+ *
+ * Runs the cooperative scheduler, which executes the registered tasks
+ * in priority order with per-task runtime accounting; see setup() for
+ * the task table.
+ */
+void loop() {
+  sched.run(net);
 }
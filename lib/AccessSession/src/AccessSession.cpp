@@ -0,0 +1,233 @@
+/**
+ * @file AccessSession.cpp
+ * @brief Implementation of the AccessSession state machine class.
+ *
+ * @ingroup infrastructure
+ */
+
+#include "AccessSession.h"
+
+/**
+ * @brief Constructs a session in the Idle state.
+ */
+AccessSession::AccessSession()
+  : net(nullptr),
+    current(AccessState::Idle),
+    enteredAt(0),
+    handler(nullptr) {
+
+  for (uint8_t i = 0; i < ACCESS_STATE_COUNT; i++) {
+    timeouts[i] = 0;
+    remoteAccepted[i] = true;
+  }
+}
+
+/**
+ * @brief Attaches the session to the MQTT client used for broadcasts.
+ *
+ * @param client MQTT client wrapper.
+ */
+void AccessSession::begin(WifiMqttClient& client) {
+  net = &client;
+  enteredAt = millis();
+}
+
+/**
+ * @brief Sets the timeout after which a state falls back to Idle.
+ *
+ * @param state State to configure.
+ * @param ms Timeout in milliseconds; 0 disables the timeout.
+ */
+void AccessSession::setTimeout(AccessState state, uint32_t ms) {
+  timeouts[(uint8_t)state] = ms;
+}
+
+/**
+ * @brief Controls whether a state may be entered via peer broadcast.
+ *
+ * @param state State to configure.
+ * @param accept true to accept the state from peers.
+ */
+void AccessSession::acceptRemote(AccessState state, bool accept) {
+  remoteAccepted[(uint8_t)state] = accept;
+}
+
+/**
+ * @brief Registers the state change handler.
+ *
+ * @param h Handler function, or nullptr to disable.
+ */
+void AccessSession::onChange(ChangeHandler h) {
+  handler = h;
+}
+
+/**
+ * @brief Checks whether the flow allows a transition.
+ *
+ * Idle may start any flow, and every state may fall back to Idle.
+ * A node that missed an intermediate broadcast can therefore still
+ * follow a peer (e.g. Idle -> Unlocked on the actuator fast path).
+ *
+ * @param from Current state.
+ * @param to Target state.
+ * @return true if the edge is part of the session flow.
+ */
+bool AccessSession::allowedEdge(AccessState from, AccessState to) {
+
+  // Falling back to Idle is always legal
+  if (to == AccessState::Idle) return true;
+
+  switch (from) {
+    case AccessState::Idle:
+      return true;
+    case AccessState::RfidPending:
+      return to == AccessState::PinEntry || to == AccessState::Lockout;
+    case AccessState::PinEntry:
+      return to == AccessState::Unlocked || to == AccessState::Lockout;
+    case AccessState::Unlocked:
+    case AccessState::Lockout:
+    default:
+      return false;
+  }
+}
+
+/**
+ * @brief Performs a local state transition and broadcasts it.
+ *
+ * @param next Target state.
+ * @return true if the state changed.
+ */
+bool AccessSession::transition(AccessState next) {
+
+  // Already there: peers raced us to the same conclusion
+  if (next == current) return false;
+
+  if (!allowedEdge(current, next)) {
+    Serial.print(F("AccessSession: rejected "));
+    Serial.print(stateName(current));
+    Serial.print(F(" -> "));
+    Serial.println(stateName(next));
+    return false;
+  }
+
+  enter(next, false);
+  broadcast();
+  return true;
+}
+
+/**
+ * @brief Applies a peer's state broadcast.
+ *
+ * @param payload Raw "session/state" payload bytes.
+ * @param length Payload length.
+ */
+void AccessSession::applyRemote(const uint8_t* payload, size_t length) {
+
+  PackedReader frame(payload, length);
+  if (!frame.valid() || frame.event() != PackedEvent::Status) return;
+
+  // The broker echoes our own broadcasts back to us
+  if (net != nullptr && frame.chipId() == net->deviceChipId()) return;
+
+  uint8_t raw = frame.readU8(PackedTag::State, 0xFF);
+  if (raw >= ACCESS_STATE_COUNT) return;
+
+  AccessState next = (AccessState)raw;
+  if (next == current) return;
+
+  if (!remoteAccepted[raw]) {
+    Serial.print(F("AccessSession: remote "));
+    Serial.print(stateName(next));
+    Serial.println(F(" not accepted on this node"));
+    return;
+  }
+
+  // Convergence wins over edge validation here: the peer saw an event
+  // this node missed, so follow it rather than drift apart
+  enter(next, true);
+}
+
+/** @brief Returns the current state. */
+AccessState AccessSession::state() const {
+  return current;
+}
+
+/**
+ * @brief Checks the current state.
+ *
+ * @param s State to compare against.
+ * @return true if the session is in state s.
+ */
+bool AccessSession::is(AccessState s) const {
+  return current == s;
+}
+
+/** @brief Returns the time (ms) spent in the current state. */
+uint32_t AccessSession::stateAge() const {
+  return millis() - enteredAt;
+}
+
+/**
+ * @brief Applies the timeout fallback of the current state.
+ */
+void AccessSession::loop() {
+
+  const uint32_t timeout = timeouts[(uint8_t)current];
+  if (timeout == 0) return;
+
+  if ((int32_t)(millis() - (enteredAt + timeout)) >= 0) {
+    Serial.print(F("AccessSession: "));
+    Serial.print(stateName(current));
+    Serial.println(F(" timed out"));
+
+    enter(AccessState::Idle, false);
+    broadcast();
+  }
+}
+
+/**
+ * @brief Returns a printable state name for logging.
+ *
+ * @param s State value.
+ * @return Flash-resident state name.
+ */
+const __FlashStringHelper* AccessSession::stateName(AccessState s) {
+  switch (s) {
+    case AccessState::Idle:        return F("Idle");
+    case AccessState::RfidPending: return F("RfidPending");
+    case AccessState::PinEntry:    return F("PinEntry");
+    case AccessState::Unlocked:    return F("Unlocked");
+    case AccessState::Lockout:     return F("Lockout");
+    default:                       return F("?");
+  }
+}
+
+/**
+ * @brief Switches state and invokes the change handler.
+ *
+ * @param next Target state.
+ * @param remote true if triggered by a peer broadcast.
+ */
+void AccessSession::enter(AccessState next, bool remote) {
+  const AccessState previous = current;
+
+  current = next;
+  enteredAt = millis();
+
+  if (handler != nullptr) {
+    handler(previous, next, remote);
+  }
+}
+
+/**
+ * @brief Publishes the current state on "session/state".
+ */
+void AccessSession::broadcast() {
+  if (net == nullptr) return;
+
+  PackedWriter frame;
+  frame.begin(PackedEvent::Status, net->deviceChipId());
+  frame.addU8(PackedTag::State, (uint8_t)current);
+
+  net->publishPacked("session/state", frame);
+}
@@ -0,0 +1,206 @@
+/**
+ * @file AccessSession.h
+ * @brief Shared access-control session state machine with MQTT state sync.
+ *
+ * @ingroup infrastructure
+ *
+ * @details
+ * This header defines the AccessSession class, which replaces the
+ * per-sketch session globals (rfidAccess, kpEnabled, accessGranted,
+ * textshown, unlocked) with one explicit state machine shared by all
+ * three nodes:
+ *
+ *   Idle -> RfidPending -> PinEntry -> Unlocked -> Idle
+ *                      \-> Lockout  -> Idle
+ *
+ * - Transitions are validated, so a node cannot wander into a state
+ *   the flow does not allow
+ * - Each state has a configurable timeout that falls back to Idle,
+ *   replacing the scattered showTextUntil / unlockUntil timers
+ * - Every local transition is broadcast as a compact packed frame on
+ *   the "session/state" topic, so peers converge within one MQTT
+ *   delivery instead of timing out independently
+ *
+ * Each sketch keeps its own side effects (LCD text, LEDs, servo,
+ * buzzer) in an onChange handler; only the state itself is shared.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiMqttClient.h>
+
+/**
+ * @brief Access session states, in flow order.
+ */
+enum class AccessState : uint8_t {
+  Idle        = 0,  /**< Waiting for a card scan */
+  RfidPending = 1,  /**< Access request published, awaiting decision */
+  PinEntry    = 2,  /**< RFID accepted, keypad input window open */
+  Unlocked    = 3,  /**< Door open, relock timer running */
+  Lockout     = 4   /**< Denied, showing/sounding the refusal */
+};
+
+/** @brief Number of states in AccessState. */
+constexpr uint8_t ACCESS_STATE_COUNT = 5;
+
+/**
+ * @class AccessSession
+ * @brief Validated, timed, broadcast-synchronized session state.
+ *
+ * Typical usage:
+ * @code
+ *   AccessSession session;
+ *   session.begin(net);
+ *   session.setTimeout(AccessState::PinEntry, 15000);
+ *   session.onChange(handleSessionChange);
+ *   ...
+ *   session.transition(AccessState::PinEntry);   // local event
+ *   session.applyRemote(payload, length);        // "session/state" frame
+ *   session.loop();                              // timeout fallbacks
+ * @endcode
+ */
+class AccessSession {
+public:
+  /**
+   * @brief State change notification handler.
+   *
+   * Called synchronously from transition(), applyRemote(), and loop().
+   *
+   * @param from Previous state.
+   * @param to New state.
+   * @param remote true if the change came from a peer broadcast.
+   */
+  typedef void (*ChangeHandler)(AccessState from, AccessState to, bool remote);
+
+  /** @brief Constructs a session in the Idle state. */
+  AccessSession();
+
+  /**
+   * @brief Attaches the session to the MQTT client used for broadcasts.
+   *
+   * The sketch must also subscribe the "session/state" topic and route
+   * its payloads to applyRemote().
+   *
+   * @param client MQTT client wrapper.
+   */
+  void begin(WifiMqttClient& client);
+
+  /**
+   * @brief Sets the timeout after which a state falls back to Idle.
+   *
+   * @param state State to configure.
+   * @param ms Timeout in milliseconds; 0 disables the timeout.
+   */
+  void setTimeout(AccessState state, uint32_t ms);
+
+  /**
+   * @brief Controls whether a state may be entered via peer broadcast.
+   *
+   * All states are accepted by default. The actuator node rejects
+   * remote Unlocked so the door only moves on a verified local path.
+   *
+   * @param state State to configure.
+   * @param accept true to accept the state from peers.
+   */
+  void acceptRemote(AccessState state, bool accept);
+
+  /**
+   * @brief Registers the state change handler.
+   *
+   * @param handler Handler function, or nullptr to disable.
+   */
+  void onChange(ChangeHandler handler);
+
+  /**
+   * @brief Performs a local state transition and broadcasts it.
+   *
+   * Invalid transitions are rejected with a Serial warning; a
+   * transition into the current state is a silent no-op.
+   *
+   * @param next Target state.
+   * @return true if the state changed.
+   */
+  bool transition(AccessState next);
+
+  /**
+   * @brief Applies a peer's state broadcast.
+   *
+   * Frames from this node's own chip ID, malformed frames, and states
+   * blocked by acceptRemote() are ignored. Accepted changes are not
+   * re-broadcast.
+   *
+   * @param payload Raw "session/state" payload bytes.
+   * @param length Payload length.
+   */
+  void applyRemote(const uint8_t* payload, size_t length);
+
+  /** @brief Returns the current state. */
+  AccessState state() const;
+
+  /**
+   * @brief Checks the current state.
+   *
+   * @param s State to compare against.
+   * @return true if the session is in state s.
+   */
+  bool is(AccessState s) const;
+
+  /** @brief Returns the time (ms) spent in the current state. */
+  uint32_t stateAge() const;
+
+  /**
+   * @brief Applies the timeout fallback of the current state.
+   *
+   * Call frequently from the Arduino loop(). A timed-out state falls
+   * back to Idle, and the fallback is broadcast like any transition.
+   */
+  void loop();
+
+  /**
+   * @brief Returns a printable state name for logging.
+   *
+   * @param s State value.
+   * @return Flash-resident state name.
+   */
+  static const __FlashStringHelper* stateName(AccessState s);
+
+private:
+  /**
+   * @brief Checks whether the flow allows a transition.
+   *
+   * @param from Current state.
+   * @param to Target state.
+   * @return true if the edge is part of the session flow.
+   */
+  static bool allowedEdge(AccessState from, AccessState to);
+
+  /**
+   * @brief Switches state and invokes the change handler.
+   *
+   * @param next Target state.
+   * @param remote true if triggered by a peer broadcast.
+   */
+  void enter(AccessState next, bool remote);
+
+  /** @brief Publishes the current state on "session/state". */
+  void broadcast();
+
+  /** @brief MQTT client used for broadcasts (not owned). */
+  WifiMqttClient* net;
+
+  /** @brief Current session state. */
+  AccessState current;
+
+  /** @brief Timestamp (ms) when the current state was entered. */
+  uint32_t enteredAt;
+
+  /** @brief Per-state fallback timeouts (ms); 0 = none. */
+  uint32_t timeouts[ACCESS_STATE_COUNT];
+
+  /** @brief Per-state remote acceptance flags. */
+  bool remoteAccepted[ACCESS_STATE_COUNT];
+
+  /** @brief Registered state change handler. */
+  ChangeHandler handler;
+};
@@ -0,0 +1,123 @@
+/**
+ * @file CoopScheduler.cpp
+ * @brief Implementation of the CoopScheduler task table.
+ *
+ * @ingroup infrastructure
+ */
+
+#include "CoopScheduler.h"
+#include <ArduinoJson.h>
+
+/**
+ * @brief Constructs an empty scheduler.
+ */
+CoopScheduler::CoopScheduler()
+  : count(0),
+    nextReport(REPORT_INTERVAL_MS) {}
+
+/**
+ * @brief Registers a task.
+ *
+ * @param name Task name for the report (string literal).
+ * @param fn Task entry point.
+ * @param intervalMs Minimum interval between runs; 0 = every pass.
+ * @param priority Execution order within a pass (lower runs first).
+ * @return Task ID, or -1 if the table is full.
+ */
+int8_t CoopScheduler::addTask(const char* name, TaskFn fn,
+                              uint32_t intervalMs, uint8_t priority) {
+  if (count >= MAX_TASKS || fn == nullptr) {
+    Serial.println("CoopScheduler: task table full");
+    return -1;
+  }
+
+  // Insertion sort by priority keeps run() a plain forward scan
+  uint8_t pos = count;
+  while (pos > 0 && tasks[pos - 1].priority > priority) {
+    tasks[pos] = tasks[pos - 1];
+    pos--;
+  }
+
+  tasks[pos].name       = name;
+  tasks[pos].fn         = fn;
+  tasks[pos].intervalMs = intervalMs;
+  tasks[pos].nextRun    = 0;
+  tasks[pos].priority   = priority;
+  tasks[pos].runs       = 0;
+  tasks[pos].maxUs      = 0;
+  tasks[pos].totalUs    = 0;
+
+  count++;
+  return (int8_t)pos;
+}
+
+/**
+ * @brief Executes one scheduler pass.
+ *
+ * @param client MQTT client used for the report.
+ */
+void CoopScheduler::run(WifiMqttClient& client) {
+
+  for (uint8_t i = 0; i < count; i++) {
+    Task& task = tasks[i];
+
+    // Interval gating; 0 means run on every pass
+    const uint32_t now = millis();
+    if (task.intervalMs != 0 && (int32_t)(now - task.nextRun) < 0) {
+      continue;
+    }
+    task.nextRun = now + task.intervalMs;
+
+    // Run the task under the microsecond clock
+    const uint32_t started = micros();
+    task.fn();
+    const uint32_t elapsed = micros() - started;
+
+    task.runs++;
+    task.totalUs += elapsed;
+    if (elapsed > task.maxUs) task.maxUs = elapsed;
+
+    // Feed the watchdog between tasks so a full pass never trips it
+    yield();
+  }
+
+  if ((int32_t)(millis() - nextReport) >= 0) {
+    publishReport(client);
+    nextReport = millis() + REPORT_INTERVAL_MS;
+  }
+}
+
+/**
+ * @brief Publishes the runtime report and resets the window.
+ *
+ * One object per task: {"runs": n, "max_us": m, "avg_us": a}, keyed by
+ * task name, on the "metrics/tasks" topic.
+ *
+ * @param client MQTT client used for the report.
+ */
+void CoopScheduler::publishReport(WifiMqttClient& client) {
+  StaticJsonDocument<512> data;
+
+  for (uint8_t i = 0; i < count; i++) {
+    Task& task = tasks[i];
+    if (task.runs == 0) continue;
+
+    JsonObject entry = data.createNestedObject(task.name);
+    entry["runs"]   = task.runs;
+    entry["max_us"] = task.maxUs;
+    entry["avg_us"] = (uint32_t)(task.totalUs / task.runs);
+
+    // Reset the report window
+    task.runs    = 0;
+    task.maxUs   = 0;
+    task.totalUs = 0;
+  }
+
+  // Heap gauge: a shrinking max_block with stable free heap means
+  // fragmentation is building up
+  JsonObject heap = data.createNestedObject("heap");
+  heap["free"]      = client.freeHeap();
+  heap["max_block"] = client.largestHeapBlock();
+
+  client.publishJson("metrics/tasks", data);
+}
@@ -0,0 +1,109 @@
+/**
+ * @file CoopScheduler.h
+ * @brief Cooperative task scheduler with per-task runtime accounting.
+ *
+ * @ingroup infrastructure
+ *
+ * @details
+ * This header defines the CoopScheduler class, which replaces the
+ * hand-rolled millis() deltas scattered across the sketches with one
+ * fixed-size task table:
+ *
+ * - Tasks are registered once in setup() with a name, interval, and
+ *   priority; the table is static, so no allocation ever happens
+ * - run() executes every due task in priority order and calls yield()
+ *   between tasks, so a full pass can never trip the ESP8266 software
+ *   watchdog no matter how the task list grows
+ * - Each task's runtime is measured with micros(); a per-task report
+ *   (runs, max, average) is published on "metrics/tasks" once a
+ *   minute, giving real numbers for worst-case latency instead of
+ *   whatever the old if-chains happened to impose
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiMqttClient.h>
+
+/**
+ * @class CoopScheduler
+ * @brief Fixed-size, priority-ordered cooperative task table.
+ *
+ * Typical usage:
+ * @code
+ *   CoopScheduler sched;
+ *   ...
+ *   sched.addTask("net", netTask, 0, 0);        // every pass, first
+ *   sched.addTask("rfid", rfidTask, 0, 1);
+ *   sched.addTask("persist", persistTask, 250, 4);
+ *   ...
+ *   void loop() { sched.run(net); }
+ * @endcode
+ *
+ * Lower priority values run earlier within a pass.
+ */
+class CoopScheduler {
+public:
+  /** @brief Maximum number of registered tasks. */
+  static constexpr uint8_t MAX_TASKS = 10;
+
+  /** @brief Interval (ms) between published task reports. */
+  static constexpr uint32_t REPORT_INTERVAL_MS = 60000;
+
+  /** @brief Task entry point. */
+  typedef void (*TaskFn)();
+
+  /** @brief Constructs an empty scheduler. */
+  CoopScheduler();
+
+  /**
+   * @brief Registers a task.
+   *
+   * Call from setup(), before the first run(). Tasks are kept sorted
+   * by priority, so registration order does not matter.
+   *
+   * @param name Task name for the report (string literal).
+   * @param fn Task entry point.
+   * @param intervalMs Minimum interval between runs; 0 = every pass.
+   * @param priority Execution order within a pass (lower runs first).
+   * @return Task ID, or -1 if the table is full.
+   */
+  int8_t addTask(const char* name, TaskFn fn, uint32_t intervalMs,
+                 uint8_t priority);
+
+  /**
+   * @brief Executes one scheduler pass.
+   *
+   * Runs every due task in priority order, measures each task's
+   * runtime, and feeds the watchdog between tasks. Publishes the
+   * per-task runtime report when the report interval elapses.
+   *
+   * @param client MQTT client used for the report.
+   */
+  void run(WifiMqttClient& client);
+
+private:
+  /** @brief Publishes the runtime report and resets the window. */
+  void publishReport(WifiMqttClient& client);
+
+  /** @brief One registered task. */
+  struct Task {
+    const char* name;     /**< Report name */
+    TaskFn fn;            /**< Entry point */
+    uint32_t intervalMs;  /**< Minimum run interval; 0 = every pass */
+    uint32_t nextRun;     /**< Timestamp (ms) of the next due run */
+    uint8_t priority;     /**< Execution order (lower runs first) */
+    uint32_t runs;        /**< Runs in the current report window */
+    uint32_t maxUs;       /**< Longest runtime (us) in the window */
+    uint64_t totalUs;     /**< Summed runtime (us) in the window */
+  };
+
+  /** @brief Task table, sorted by priority. */
+  Task tasks[MAX_TASKS];
+
+  /** @brief Number of registered tasks. */
+  uint8_t count;
+
+  /** @brief Timestamp (ms) of the next report. */
+  uint32_t nextReport;
+};
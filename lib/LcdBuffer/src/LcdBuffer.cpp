@@ -0,0 +1,126 @@
+/**
+ * @file LcdBuffer.cpp
+ * @brief Implementation of the LcdBuffer shadow-buffered LCD writer.
+ *
+ * @ingroup infrastructure
+ */
+
+#include "LcdBuffer.h"
+
+/**
+ * @brief Constructs a buffer bound to an LCD instance.
+ *
+ * @param display Initialized LiquidCrystal_I2C instance (not owned).
+ */
+LcdBuffer::LcdBuffer(LiquidCrystal_I2C& display)
+  : lcd(display),
+    scanPos(0),
+    pendingCells(0) {
+
+  memset(desired, ' ', sizeof(desired));
+  memset(shown, ' ', sizeof(shown));
+}
+
+/**
+ * @brief Synchronizes the shadow buffers with a cleared display.
+ */
+void LcdBuffer::begin() {
+  memset(desired, ' ', sizeof(desired));
+  memset(shown, ' ', sizeof(shown));
+
+  scanPos = 0;
+  pendingCells = 0;
+}
+
+/**
+ * @brief Writes a RAM-resident string to a framebuffer line.
+ *
+ * @param msg C-string to display (truncated to the line width).
+ * @param line LCD row index.
+ */
+void LcdBuffer::printLine(const char* msg, uint8_t line) {
+  if (line >= ROWS) return;
+
+  for (uint8_t col = 0; col < COLS; col++) {
+
+    // Pad with spaces past the end of the message
+    const char c = (*msg != '\0') ? *msg++ : ' ';
+
+    if (desired[line][col] != c) {
+      // Track how many cells newly diverge from the glass
+      if (desired[line][col] == shown[line][col]) pendingCells++;
+      else if (c == shown[line][col]) pendingCells--;
+
+      desired[line][col] = c;
+    }
+  }
+}
+
+/**
+ * @brief Writes a flash-resident string to a framebuffer line.
+ *
+ * @param msg Flash string (use F("...")).
+ * @param line LCD row index.
+ */
+void LcdBuffer::printLine(const __FlashStringHelper* msg, uint8_t line) {
+  char buffer[COLS + 1];
+
+  strncpy_P(buffer, (PGM_P)msg, COLS);
+  buffer[COLS] = '\0';
+
+  printLine(buffer, line);
+}
+
+/**
+ * @brief Sends a budgeted batch of changed cells to the glass.
+ */
+void LcdBuffer::loop() {
+  if (pendingCells == 0) return;
+
+  uint8_t budget = FLUSH_BUDGET;
+
+  // Track the glass cursor so runs of changed cells need one setCursor
+  int16_t cursorRow = -1;
+  int16_t cursorCol = -1;
+
+  for (uint8_t scanned = 0; scanned < ROWS * COLS && budget > 0; scanned++) {
+
+    const uint8_t row = scanPos / COLS;
+    const uint8_t col = scanPos % COLS;
+    scanPos = (scanPos + 1) % (ROWS * COLS);
+
+    if (desired[row][col] == shown[row][col]) continue;
+
+    // Position the cursor unless it already points at this cell
+    if (row != cursorRow || col != cursorCol) {
+      lcd.setCursor(col, row);
+    }
+
+    lcd.write(desired[row][col]);
+    shown[row][col] = desired[row][col];
+    pendingCells--;
+    budget--;
+
+    // The controller advances the cursor after a data write
+    cursorRow = row;
+    cursorCol = col + 1;
+  }
+}
+
+/**
+ * @brief Drains all pending changes synchronously.
+ */
+void LcdBuffer::flush() {
+  while (pendingCells > 0) {
+    loop();
+  }
+}
+
+/**
+ * @brief Checks whether the glass matches the framebuffer.
+ *
+ * @return true if no cell updates are pending.
+ */
+bool LcdBuffer::idle() const {
+  return pendingCells == 0;
+}
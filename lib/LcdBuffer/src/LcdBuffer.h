@@ -0,0 +1,129 @@
+/**
+ * @file LcdBuffer.h
+ * @brief Shadow-buffered, non-blocking writer for the I2C character LCD.
+ *
+ * @ingroup infrastructure
+ *
+ * @details
+ * This header defines the LcdBuffer class, which takes LCD updates off
+ * the hot path. Writing a line directly with LiquidCrystal_I2C pushes
+ * 16 blank characters plus the message over I2C synchronously, freezing
+ * MQTT and RFID processing for several milliseconds per line — on every
+ * keypress in the masked-PIN path.
+ *
+ * With LcdBuffer, printLine() only touches a 2x16 RAM framebuffer and
+ * returns in microseconds. A differ in loop() compares the framebuffer
+ * against what is on the glass and sends only changed cells, at most a
+ * small budget per loop pass, so no single pass blocks for long.
+ * Identical rewrites (same prompt printed again) cost no I2C traffic
+ * at all.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <LiquidCrystal_I2C.h>
+
+/**
+ * @class LcdBuffer
+ * @brief RAM framebuffer plus budgeted differ for a character LCD.
+ *
+ * Typical usage:
+ * @code
+ *   LiquidCrystal_I2C lcd(0x27, 16, 2);
+ *   LcdBuffer lcdBuf(lcd);
+ *   ...
+ *   lcd.init();
+ *   lcdBuf.begin();
+ *   ...
+ *   lcdBuf.printLine(F("Enter PIN:"), 0);  // RAM only, returns fast
+ *   ...
+ *   lcdBuf.loop();                         // sends a few cells per pass
+ * @endcode
+ *
+ * Backlight control stays on the LiquidCrystal_I2C instance; only cell
+ * contents go through the buffer.
+ */
+class LcdBuffer {
+public:
+  /** @brief Display width in characters. */
+  static constexpr uint8_t COLS = 16;
+
+  /** @brief Display height in lines. */
+  static constexpr uint8_t ROWS = 2;
+
+  /** @brief Maximum cells written to the glass per loop() pass. */
+  static constexpr uint8_t FLUSH_BUDGET = 4;
+
+  /**
+   * @brief Constructs a buffer bound to an LCD instance.
+   *
+   * @param display Initialized LiquidCrystal_I2C instance (not owned).
+   */
+  explicit LcdBuffer(LiquidCrystal_I2C& display);
+
+  /**
+   * @brief Synchronizes the shadow buffers with a cleared display.
+   *
+   * Call once after lcd.init() / lcd.clear() in setup().
+   */
+  void begin();
+
+  /**
+   * @brief Writes a RAM-resident string to a framebuffer line.
+   *
+   * The line is padded with spaces, so old content never shows
+   * through. No I2C traffic happens here.
+   *
+   * @param msg C-string to display (truncated to the line width).
+   * @param line LCD row index.
+   */
+  void printLine(const char* msg, uint8_t line);
+
+  /**
+   * @brief Writes a flash-resident string to a framebuffer line.
+   *
+   * @param msg Flash string (use F("...")).
+   * @param line LCD row index.
+   */
+  void printLine(const __FlashStringHelper* msg, uint8_t line);
+
+  /**
+   * @brief Sends a budgeted batch of changed cells to the glass.
+   *
+   * Call frequently from the Arduino loop(). Each pass writes at most
+   * FLUSH_BUDGET cells, scanning round-robin so no region starves.
+   */
+  void loop();
+
+  /**
+   * @brief Drains all pending changes synchronously.
+   *
+   * Used before entering power-save mode so the glass matches the
+   * framebuffer when updates stop.
+   */
+  void flush();
+
+  /**
+   * @brief Checks whether the glass matches the framebuffer.
+   *
+   * @return true if no cell updates are pending.
+   */
+  bool idle() const;
+
+private:
+  /** @brief Bound display instance (not owned). */
+  LiquidCrystal_I2C& lcd;
+
+  /** @brief Desired display contents. */
+  char desired[ROWS][COLS];
+
+  /** @brief Contents currently on the glass. */
+  char shown[ROWS][COLS];
+
+  /** @brief Round-robin scan position (0 .. ROWS*COLS-1). */
+  uint8_t scanPos;
+
+  /** @brief Number of cells where desired and shown differ. */
+  uint8_t pendingCells;
+};
@@ -0,0 +1,233 @@
+/**
+ * @file UidCache.cpp
+ * @brief Implementation of the UidCache flash-backed LRU cache.
+ *
+ * @ingroup infrastructure
+ */
+
+#include "UidCache.h"
+#include <LittleFS.h>
+
+/**
+ * @brief Path of the persisted cache file on LittleFS.
+ */
+static constexpr const char* CACHE_FILE = "/uidcache.bin";
+
+/**
+ * @brief Delay (ms) between a cache change and its flash write.
+ *
+ * Debounces bursts of inserts into a single write to limit flash wear.
+ */
+static constexpr uint32_t SAVE_DEBOUNCE_MS = 2000;
+
+/**
+ * @brief Default constructor.
+ *
+ * Initializes an empty, unmounted cache.
+ */
+UidCache::UidCache()
+  : count(0),
+    fsReady(false),
+    dirty(false),
+    dirtySince(0) {}
+
+/**
+ * @brief Mounts LittleFS and loads the persisted cache file.
+ *
+ * Missing or truncated cache files are treated as an empty cache.
+ *
+ * @return true if the filesystem is available, false otherwise.
+ */
+bool UidCache::begin() {
+
+  fsReady = LittleFS.begin();
+
+  if (!fsReady) {
+    Serial.println("UidCache: LittleFS mount failed");
+    return false;
+  }
+
+  File f = LittleFS.open(CACHE_FILE, "r");
+
+  // No cache file yet: start empty
+  if (!f) return true;
+
+  // Read entry count followed by the hash table
+  uint8_t stored = 0;
+  if (f.read(&stored, 1) == 1 && stored <= CAPACITY) {
+    size_t want = stored * sizeof(uint32_t);
+    if (f.read(reinterpret_cast<uint8_t*>(entries), want) == want) {
+      count = stored;
+    }
+  }
+
+  f.close();
+
+  Serial.printf("UidCache: loaded %u entries\n", count);
+  return true;
+}
+
+/**
+ * @brief Computes the 32-bit FNV-1a hash of a UID string.
+ *
+ * @param uidHex UID as a hex string.
+ * @return 32-bit hash value.
+ */
+uint32_t UidCache::hashUid(const char* uidHex) {
+  uint32_t hash = 2166136261u;  // FNV offset basis
+
+  while (*uidHex) {
+    hash ^= (uint8_t)*uidHex++;
+    hash *= 16777619u;          // FNV prime
+  }
+
+  return hash;
+}
+
+/**
+ * @brief Finds the table index of a hash.
+ *
+ * @param hash Hash to look up.
+ * @return Index into the entry table, or -1 if absent.
+ */
+int8_t UidCache::findEntry(uint32_t hash) const {
+  for (uint8_t i = 0; i < count; i++) {
+    if (entries[i] == hash) return i;
+  }
+  return -1;
+}
+
+/**
+ * @brief Moves an entry to the most-recently-used position.
+ *
+ * Shifts intervening entries down by one slot.
+ *
+ * @param index Index of the entry to promote.
+ */
+void UidCache::touch(uint8_t index) {
+  if (index == 0) return;
+
+  uint32_t hash = entries[index];
+
+  // Shift more-recent entries down one slot
+  memmove(&entries[1], &entries[0], index * sizeof(uint32_t));
+
+  entries[0] = hash;
+}
+
+/**
+ * @brief Checks whether a UID is currently authorized in the cache.
+ *
+ * @param uidHex UID as an uppercase hex string.
+ * @return true if the UID is cached, false otherwise.
+ */
+bool UidCache::check(const char* uidHex) {
+  int8_t index = findEntry(hashUid(uidHex));
+
+  if (index < 0) return false;
+
+  // Refresh LRU position on hit
+  touch(index);
+  return true;
+}
+
+/**
+ * @brief Inserts (or refreshes) a UID in the cache.
+ *
+ * @param uidHex UID as an uppercase hex string.
+ */
+void UidCache::insert(const char* uidHex) {
+  uint32_t hash = hashUid(uidHex);
+  int8_t index = findEntry(hash);
+
+  // Already cached: just refresh LRU position
+  if (index >= 0) {
+    touch(index);
+    return;
+  }
+
+  // Grow table, or evict the least-recently-used entry (last slot)
+  if (count < CAPACITY) {
+    count++;
+  }
+
+  // Shift all entries down and place the new hash at the front
+  memmove(&entries[1], &entries[0], (count - 1) * sizeof(uint32_t));
+  entries[0] = hash;
+
+  dirty = true;
+  dirtySince = millis();
+}
+
+/**
+ * @brief Removes a single UID from the cache.
+ *
+ * @param uidHex UID as an uppercase hex string.
+ * @return true if the UID was present and removed, false otherwise.
+ */
+bool UidCache::revoke(const char* uidHex) {
+  int8_t index = findEntry(hashUid(uidHex));
+
+  if (index < 0) return false;
+
+  // Close the gap left by the removed entry
+  memmove(&entries[index], &entries[index + 1],
+          (count - index - 1) * sizeof(uint32_t));
+  count--;
+
+  dirty = true;
+  dirtySince = millis();
+  return true;
+}
+
+/**
+ * @brief Removes all entries from the cache.
+ */
+void UidCache::clear() {
+  if (count == 0) return;
+
+  count = 0;
+  dirty = true;
+  dirtySince = millis();
+}
+
+/**
+ * @brief Persists dirty cache state to flash.
+ *
+ * Debounced: writes happen SAVE_DEBOUNCE_MS after the last change.
+ */
+void UidCache::loop() {
+  if (!dirty || !fsReady) return;
+
+  // Wait out the debounce window before touching flash
+  if ((int32_t)(millis() - (dirtySince + SAVE_DEBOUNCE_MS)) < 0) return;
+
+  save();
+  dirty = false;
+}
+
+/**
+ * @brief Writes the entry table to the LittleFS cache file.
+ */
+void UidCache::save() {
+  File f = LittleFS.open(CACHE_FILE, "w");
+
+  if (!f) {
+    Serial.println("UidCache: save failed");
+    return;
+  }
+
+  f.write(&count, 1);
+  f.write(reinterpret_cast<const uint8_t*>(entries),
+          count * sizeof(uint32_t));
+  f.close();
+}
+
+/**
+ * @brief Returns the number of cached entries.
+ *
+ * @return Entry count (0..CAPACITY).
+ */
+uint8_t UidCache::size() const {
+  return count;
+}
@@ -0,0 +1,151 @@
+/**
+ * @file UidCache.h
+ * @brief Flash-backed LRU cache of recently authorized RFID UID hashes.
+ *
+ * @ingroup infrastructure
+ *
+ * @details
+ * This header defines the UidCache class, which keeps a small, fixed-size
+ * table of hashed UIDs that the backend has recently authorized. A cache hit
+ * lets the RFID node show "Enter PIN:" immediately instead of waiting for a
+ * broker round trip; the backend request is still published in the background
+ * for auditing.
+ *
+ * Properties:
+ * - UIDs are stored as 32-bit FNV-1a hashes, never as plaintext
+ * - Least-recently-used entries are evicted when the table is full
+ * - The table is persisted to LittleFS so it survives reboots
+ * - Entries can be revoked individually (or wholesale) via MQTT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @class UidCache
+ * @brief Fixed-size, LRU-evicted, flash-persisted cache of UID hashes.
+ *
+ * Typical usage:
+ * @code
+ *   UidCache cache;
+ *   cache.begin();                    // mount LittleFS and load entries
+ *   if (cache.check(uidString)) { ...fast path... }
+ *   cache.insert(uidString);          // on backend "access granted"
+ *   cache.revoke(uidString);          // on revocation message
+ * @endcode
+ */
+class UidCache {
+public:
+  /** @brief Maximum number of cached UID hashes. */
+  static constexpr uint8_t CAPACITY = 16;
+
+  /**
+   * @brief Default constructor.
+   *
+   * Initializes an empty cache; no filesystem access is performed
+   * until begin() is called.
+   */
+  UidCache();
+
+  /**
+   * @brief Mounts LittleFS and loads the persisted cache file.
+   *
+   * Safe to call when no cache file exists yet (starts empty).
+   *
+   * @return true if the filesystem is available, false otherwise.
+   */
+  bool begin();
+
+  /**
+   * @brief Checks whether a UID is currently authorized in the cache.
+   *
+   * A hit refreshes the entry's LRU position.
+   *
+   * @param uidHex UID as an uppercase hex string.
+   * @return true if the UID is cached, false otherwise.
+   */
+  bool check(const char* uidHex);
+
+  /**
+   * @brief Inserts (or refreshes) a UID in the cache.
+   *
+   * Evicts the least-recently-used entry when the table is full
+   * and schedules a flash write.
+   *
+   * @param uidHex UID as an uppercase hex string.
+   */
+  void insert(const char* uidHex);
+
+  /**
+   * @brief Removes a single UID from the cache.
+   *
+   * @param uidHex UID as an uppercase hex string.
+   * @return true if the UID was present and removed, false otherwise.
+   */
+  bool revoke(const char* uidHex);
+
+  /**
+   * @brief Removes all entries from the cache.
+   *
+   * Used for fleet-wide revocation messages.
+   */
+  void clear();
+
+  /**
+   * @brief Persists dirty cache state to flash.
+   *
+   * Writes are debounced; call this frequently from loop() and the
+   * cache decides when a write is actually due.
+   */
+  void loop();
+
+  /**
+   * @brief Returns the number of cached entries.
+   *
+   * @return Entry count (0..CAPACITY).
+   */
+  uint8_t size() const;
+
+private:
+  /**
+   * @brief Computes the 32-bit FNV-1a hash of a UID string.
+   *
+   * @param uidHex UID as a hex string.
+   * @return 32-bit hash value.
+   */
+  static uint32_t hashUid(const char* uidHex);
+
+  /**
+   * @brief Finds the table index of a hash.
+   *
+   * @param hash Hash to look up.
+   * @return Index into the entry table, or -1 if absent.
+   */
+  int8_t findEntry(uint32_t hash) const;
+
+  /**
+   * @brief Moves an entry to the most-recently-used position.
+   *
+   * @param index Index of the entry to promote.
+   */
+  void touch(uint8_t index);
+
+  /** @brief Writes the entry table to the LittleFS cache file. */
+  void save();
+
+  /** @brief Cached UID hashes, ordered most-recently-used first. */
+  uint32_t entries[CAPACITY];
+
+  /** @brief Number of valid entries in the table. */
+  uint8_t count;
+
+  /** @brief Indicates whether LittleFS mounted successfully. */
+  bool fsReady;
+
+  /** @brief Indicates unsaved changes to the entry table. */
+  bool dirty;
+
+  /** @brief Timestamp (ms) of the last cache modification. */
+  uint32_t dirtySince;
+};
@@ -0,0 +1,312 @@
+/**
+ * @file AuditLog.cpp
+ * @brief Implementation of the flash-resident audit log.
+ *
+ * @ingroup infrastructure
+ */
+
+#include "AuditLog.h"
+#include "WiFiMqttClient.h"
+#include "PackedMessage.h"
+#include <LittleFS.h>
+
+/** @brief Paths of the two segment files, indexed by segment. */
+static constexpr const char* SEG_FILES[2] = {
+  "/audit0.bin",
+  "/audit1.bin"
+};
+
+/** @brief Path of the persisted upload-position file. */
+static constexpr const char* META_FILE = "/auditmeta.bin";
+
+/**
+ * @brief Default constructor.
+ *
+ * Initializes an empty, unmounted log.
+ */
+AuditLog::AuditLog()
+  : client(nullptr),
+    activeSeg(0),
+    readOffset(0),
+    batchSeq(1),
+    inFlight(0),
+    ackDeadline(0),
+    nextUpload(0),
+    fsReady(false) {
+  segCount[0] = 0;
+  segCount[1] = 0;
+}
+
+/**
+ * @brief Binds the log to the MQTT client and loads flash state.
+ *
+ * Missing segment or meta files are treated as an empty log.
+ *
+ * @param client MQTT client used for batch upload.
+ * @return true if the filesystem is available, false otherwise.
+ */
+bool AuditLog::begin(WifiMqttClient& client) {
+  this->client = &client;
+
+  fsReady = LittleFS.begin();
+
+  if (!fsReady) {
+    Serial.println("AuditLog: LittleFS mount failed");
+    return false;
+  }
+
+  // Mirror the segment record counts from the file sizes
+  for (uint8_t seg = 0; seg < 2; seg++) {
+    File f = LittleFS.open(SEG_FILES[seg], "r");
+    if (f) {
+      segCount[seg] = f.size() / sizeof(AuditRecord);
+      f.close();
+    }
+  }
+
+  // Restore the upload position; a missing meta file starts from zero
+  File meta = LittleFS.open(META_FILE, "r");
+  if (meta) {
+    uint8_t seg = 0;
+    uint16_t offset = 0;
+    uint32_t seq = 0;
+    if (meta.read(&seg, 1) == 1 &&
+        meta.read(reinterpret_cast<uint8_t*>(&offset), 2) == 2 &&
+        meta.read(reinterpret_cast<uint8_t*>(&seq), 4) == 4 &&
+        seg < 2) {
+      activeSeg = seg;
+      readOffset = offset;
+      batchSeq = seq;
+    }
+    meta.close();
+  }
+
+  // A meta file older than the segments could point past the end
+  uint8_t readSeg = (segCount[1 - activeSeg] > 0) ? (1 - activeSeg)
+                                                  : activeSeg;
+  if (readOffset > segCount[readSeg]) readOffset = 0;
+
+  nextUpload = millis() + UPLOAD_INTERVAL_MS;
+
+  Serial.printf("AuditLog: %u records pending upload\n", pendingRecords());
+  return true;
+}
+
+/**
+ * @brief Computes the 32-bit FNV-1a hash of a UID string.
+ *
+ * @param uidHex UID as a hex string.
+ * @return 32-bit hash value, or 0 for a null UID.
+ */
+uint32_t AuditLog::hashUid(const char* uidHex) {
+  if (uidHex == nullptr) return 0;
+
+  uint32_t hash = 2166136261u;  // FNV offset basis
+
+  while (*uidHex) {
+    hash ^= (uint8_t)*uidHex++;
+    hash *= 16777619u;          // FNV prime
+  }
+
+  return hash;
+}
+
+/**
+ * @brief Returns the file path of a segment.
+ *
+ * @param segment Segment index (0 or 1).
+ * @return Path string.
+ */
+const char* AuditLog::segPath(uint8_t segment) {
+  return SEG_FILES[segment];
+}
+
+/**
+ * @brief Returns the record count of a segment.
+ *
+ * @param segment Segment index (0 or 1).
+ * @return Record count.
+ */
+uint16_t AuditLog::segRecords(uint8_t segment) const {
+  return segCount[segment];
+}
+
+/**
+ * @brief Appends an event record to the active segment.
+ *
+ * @param event Event type code.
+ * @param granted Outcome of the event (granted / success).
+ * @param uidHex UID as a hex string, or nullptr when not applicable.
+ * @param detail Event-specific detail (e.g. PIN length), or 0.
+ */
+void AuditLog::record(AuditEvent event, bool granted,
+                      const char* uidHex, uint16_t detail) {
+  if (!fsReady) return;
+
+  if (segCount[activeSeg] >= SEGMENT_RECORDS) rotate();
+
+  AuditRecord rec;
+  rec.ts = millis();
+  rec.uidHash = hashUid(uidHex);
+  rec.event = (uint8_t)event;
+  rec.result = granted ? 1 : 0;
+  rec.detail = detail;
+
+  File f = LittleFS.open(segPath(activeSeg), "a");
+
+  if (!f) {
+    Serial.println("AuditLog: append failed");
+    return;
+  }
+
+  f.write(reinterpret_cast<const uint8_t*>(&rec), sizeof(rec));
+  f.close();
+  segCount[activeSeg]++;
+}
+
+/**
+ * @brief Rotates the append target to the other segment.
+ *
+ * When the backend has not drained the other segment yet its records
+ * are the oldest on the node and are overwritten (circular).
+ */
+void AuditLog::rotate() {
+  uint8_t next = 1 - activeSeg;
+
+  if (segCount[next] > 0) {
+    Serial.printf("AuditLog: dropping %u unuploaded records\n",
+                  segCount[next] - readOffset);
+    readOffset = 0;
+    inFlight = 0;  // The outstanding batch referenced dropped records
+  }
+
+  LittleFS.remove(segPath(next));
+  segCount[next] = 0;
+  activeSeg = next;
+  saveMeta();
+}
+
+/**
+ * @brief Composes and publishes the next batch frame.
+ *
+ * Frame payload: batch sequence (Seq), record count (Count) and the
+ * concatenated records (Batch). Re-sends reuse the same sequence, so
+ * the backend can deduplicate a batch whose ack was lost.
+ */
+void AuditLog::uploadBatch() {
+  uint8_t readSeg = (segCount[1 - activeSeg] > 0) ? (1 - activeSeg)
+                                                  : activeSeg;
+  uint16_t avail = segCount[readSeg] - readOffset;
+
+  uint8_t n = (avail < BATCH_RECORDS) ? avail : BATCH_RECORDS;
+  if (n == 0) return;
+
+  uint8_t records[BATCH_RECORDS * sizeof(AuditRecord)];
+
+  File f = LittleFS.open(segPath(readSeg), "r");
+
+  if (!f) {
+    Serial.println("AuditLog: batch read failed");
+    return;
+  }
+
+  f.seek(readOffset * sizeof(AuditRecord));
+  size_t want = n * sizeof(AuditRecord);
+  size_t got = f.read(records, want);
+  f.close();
+
+  if (got != want) {
+    Serial.println("AuditLog: batch read short");
+    return;
+  }
+
+  PackedWriter frame;
+  frame.begin(PackedEvent::AuditBatch, client->deviceChipId());
+  frame.addTlv(PackedTag::Seq, &batchSeq, 4);
+  frame.addU8(PackedTag::Count, n);
+  frame.addTlv(PackedTag::Batch, records, want);
+
+  if (client->publishPacked("audit/batch", frame)) {
+    inFlight = n;
+    ackDeadline = millis() + ACK_TIMEOUT_MS;
+  }
+}
+
+/**
+ * @brief Handles a batch acknowledgment from the "audit/ack" topic.
+ *
+ * @param batchId Acknowledged batch sequence number.
+ */
+void AuditLog::handleAck(uint32_t batchId) {
+  // Stale or duplicate ack: nothing outstanding, or wrong batch
+  if (inFlight == 0 || batchId != batchSeq) return;
+
+  readOffset += inFlight;
+  inFlight = 0;
+  batchSeq++;
+
+  // A fully acknowledged inactive segment is done: truncation is a
+  // cheap file delete, which is the point of the two-segment layout
+  uint8_t readSeg = (segCount[1 - activeSeg] > 0) ? (1 - activeSeg)
+                                                  : activeSeg;
+  if (readSeg != activeSeg && readOffset >= segCount[readSeg]) {
+    LittleFS.remove(segPath(readSeg));
+    segCount[readSeg] = 0;
+    readOffset = 0;
+  }
+
+  saveMeta();
+
+  // Drain a remaining backlog on the next pass instead of the timer
+  if (pendingRecords() > 0) nextUpload = millis();
+}
+
+/**
+ * @brief Upload service; call regularly from the scheduler.
+ */
+void AuditLog::loop() {
+  if (!fsReady || client == nullptr) return;
+
+  // Outstanding batch: wait for the ack, re-send on timeout. The
+  // re-send is also what resumes upload after an outage, since the
+  // frame is queued for delivery once the connection recovers.
+  if (inFlight > 0) {
+    if ((int32_t)(millis() - ackDeadline) >= 0) uploadBatch();
+    return;
+  }
+
+  uint16_t pending = pendingRecords();
+  if (pending == 0) return;
+
+  // High-water mark or upload timer due
+  if (pending >= HIGH_WATER || (int32_t)(millis() - nextUpload) >= 0) {
+    uploadBatch();
+    nextUpload = millis() + UPLOAD_INTERVAL_MS;
+  }
+}
+
+/**
+ * @brief Returns the number of records awaiting acknowledgment.
+ *
+ * @return Pending record count across both segments.
+ */
+uint16_t AuditLog::pendingRecords() const {
+  return segCount[0] + segCount[1] - readOffset;
+}
+
+/**
+ * @brief Persists the upload position and batch sequence to flash.
+ */
+void AuditLog::saveMeta() {
+  File f = LittleFS.open(META_FILE, "w");
+
+  if (!f) {
+    Serial.println("AuditLog: meta save failed");
+    return;
+  }
+
+  f.write(&activeSeg, 1);
+  f.write(reinterpret_cast<const uint8_t*>(&readOffset), 2);
+  f.write(reinterpret_cast<const uint8_t*>(&batchSeq), 4);
+  f.close();
+}
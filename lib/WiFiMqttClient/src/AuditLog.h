@@ -0,0 +1,216 @@
+/**
+ * @file AuditLog.h
+ * @brief Flash-resident audit log with batched, acknowledged upload.
+ *
+ * @ingroup infrastructure
+ *
+ * @details
+ * This header defines the AuditLog class, which records every scan, PIN
+ * attempt and unlock as a fixed-size binary record on LittleFS and ships
+ * the records to the backend in batches instead of one publish per event:
+ * - Records are appended write-through, so an event is on flash before
+ *   the outcome is acted on and survives an immediate power loss.
+ * - Storage alternates between two segment files; rotation truncates the
+ *   inactive file instead of rewriting one file to drop its head, and
+ *   alternating the append target lets LittleFS spread the wear.
+ * - Batches of up to BATCH_RECORDS records go out as one packed frame on
+ *   "audit/batch" when a high-water mark or upload timer fires; at 12
+ *   bytes per record one frame replaces eight ~200-byte JSON publishes.
+ * - Records are only dropped from flash after the backend acknowledges
+ *   the batch sequence number on "audit/ack" (stop-and-wait, like the
+ *   OTA chunk transfer); an unacknowledged batch is re-sent, so an
+ *   outage costs airtime, never records.
+ *
+ * UIDs are stored as 32-bit FNV-1a hashes, never as plaintext, matching
+ * the UID cache. When both segments fill before the backend drains them
+ * the oldest segment is overwritten (circular); at 256 records per
+ * segment that is several days of human-paced events.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+class WifiMqttClient;
+
+/**
+ * @brief Event type codes stored in audit records.
+ */
+enum class AuditEvent : uint8_t {
+  RfidScan   = 1,  /**< Card presented to the reader */
+  PinAttempt = 2,  /**< PIN submitted on the keypad */
+  Unlock     = 3,  /**< Door driven to the unlocked position */
+  Lockout    = 4   /**< Session entered the lockout state */
+};
+
+/**
+ * @class AuditLog
+ * @brief Append-only flash audit trail with acknowledged batch upload.
+ *
+ * Typical usage:
+ * @code
+ *   AuditLog audit;
+ *   audit.begin(net);                                  // in setup()
+ *   audit.record(AuditEvent::RfidScan, hit, uidString);
+ *   audit.handleAck(doc["data"]["batch_id"] | 0);      // on audit/ack
+ *   audit.loop();                                      // scheduled task
+ * @endcode
+ */
+class AuditLog {
+public:
+  /** @brief Records per segment file (two segments, 3 KB each). */
+  static constexpr uint16_t SEGMENT_RECORDS = 256;
+
+  /** @brief Records per uploaded batch frame. */
+  static constexpr uint8_t BATCH_RECORDS = 8;
+
+  /** @brief Pending-record count that triggers an immediate upload. */
+  static constexpr uint16_t HIGH_WATER = 16;
+
+  /** @brief Upload timer interval (ms) for trickling small backlogs. */
+  static constexpr uint32_t UPLOAD_INTERVAL_MS = 60000;
+
+  /** @brief Time (ms) to wait for a batch ack before re-sending. */
+  static constexpr uint32_t ACK_TIMEOUT_MS = 10000;
+
+  /**
+   * @brief Default constructor.
+   */
+  AuditLog();
+
+  /**
+   * @brief Binds the log to the MQTT client and loads flash state.
+   *
+   * Mounts LittleFS, counts the records in both segment files and
+   * restores the upload position, so records written before a reboot
+   * are still uploaded after it.
+   *
+   * @param client MQTT client used for batch upload.
+   * @return true if the filesystem is available, false otherwise.
+   */
+  bool begin(WifiMqttClient& client);
+
+  /**
+   * @brief Appends an event record to the active segment.
+   *
+   * The record is on flash when this returns; events are human-paced,
+   * so the per-event append is cheap against the debounce bookkeeping
+   * it would take to batch them in RAM.
+   *
+   * @param event Event type code.
+   * @param granted Outcome of the event (granted / success).
+   * @param uidHex UID as a hex string, or nullptr when not applicable.
+   * @param detail Event-specific detail (e.g. PIN length), or 0.
+   */
+  void record(AuditEvent event, bool granted,
+              const char* uidHex = nullptr, uint16_t detail = 0);
+
+  /**
+   * @brief Handles a batch acknowledgment from the "audit/ack" topic.
+   *
+   * Acknowledgment of the outstanding batch sequence number advances
+   * the upload position past the batch's records; anything else
+   * (stale or duplicate acks) is ignored.
+   *
+   * @param batchId Acknowledged batch sequence number.
+   */
+  void handleAck(uint32_t batchId);
+
+  /**
+   * @brief Upload service; call regularly from the scheduler.
+   *
+   * Sends the next batch when the high-water mark or upload timer
+   * fires, and re-sends the outstanding batch when its ack times out.
+   */
+  void loop();
+
+  /**
+   * @brief Returns the number of records awaiting acknowledgment.
+   *
+   * @return Pending record count across both segments.
+   */
+  uint16_t pendingRecords() const;
+
+private:
+  /**
+   * @brief One audit record as stored on flash and on the wire.
+   */
+  struct AuditRecord {
+    uint32_t ts;       /**< millis() at the time of the event */
+    uint32_t uidHash;  /**< FNV-1a hash of the UID, or 0 */
+    uint8_t event;     /**< AuditEvent code */
+    uint8_t result;    /**< 1 = granted / success, 0 = denied */
+    uint16_t detail;   /**< Event-specific detail value */
+  };
+
+  /**
+   * @brief Computes the 32-bit FNV-1a hash of a UID string.
+   *
+   * @param uidHex UID as a hex string.
+   * @return 32-bit hash value, or 0 for a null UID.
+   */
+  static uint32_t hashUid(const char* uidHex);
+
+  /**
+   * @brief Returns the file path of a segment.
+   *
+   * @param segment Segment index (0 or 1).
+   * @return Path string.
+   */
+  static const char* segPath(uint8_t segment);
+
+  /**
+   * @brief Returns the record count of a segment.
+   *
+   * Counts are held in RAM (loaded from the file sizes in begin()) so
+   * the scheduled upload check never touches flash.
+   *
+   * @param segment Segment index (0 or 1).
+   * @return Record count.
+   */
+  uint16_t segRecords(uint8_t segment) const;
+
+  /**
+   * @brief Rotates the append target to the other segment.
+   *
+   * Truncates the new target; records still waiting there are dropped
+   * oldest-first with a warning (circular overwrite).
+   */
+  void rotate();
+
+  /**
+   * @brief Composes and publishes the next batch frame.
+   */
+  void uploadBatch();
+
+  /** @brief Persists the upload position and batch sequence to flash. */
+  void saveMeta();
+
+  /** @brief MQTT client used for batch upload. */
+  WifiMqttClient* client;
+
+  /** @brief Segment currently receiving appends (0 or 1). */
+  uint8_t activeSeg;
+
+  /** @brief Record count per segment, mirrored from the file sizes. */
+  uint16_t segCount[2];
+
+  /** @brief Records already acknowledged in the read segment. */
+  uint16_t readOffset;
+
+  /** @brief Sequence number of the next batch to send. */
+  uint32_t batchSeq;
+
+  /** @brief Record count of the outstanding (unacknowledged) batch. */
+  uint8_t inFlight;
+
+  /** @brief Deadline (ms) for the outstanding batch ack. */
+  uint32_t ackDeadline;
+
+  /** @brief Timestamp (ms) of the next timer-driven upload. */
+  uint32_t nextUpload;
+
+  /** @brief Indicates whether LittleFS mounted successfully. */
+  bool fsReady;
+};
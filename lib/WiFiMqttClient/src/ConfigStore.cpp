@@ -0,0 +1,183 @@
+/**
+ * @file ConfigStore.cpp
+ * @brief Implementation of the ConfigStore runtime configuration class.
+ *
+ * @ingroup infrastructure
+ */
+
+#include "ConfigStore.h"
+#include <LittleFS.h>
+
+/** @brief Path of the persisted configuration file on LittleFS. */
+static constexpr const char* CONFIG_FILE = "/config.json";
+
+/** @brief Delay (ms) between an accepted change and its flash write. */
+static constexpr uint32_t SAVE_DEBOUNCE_MS = 2000;
+
+/**
+ * @brief Constructs an empty store.
+ */
+ConfigStore::ConfigStore()
+  : count(0),
+    fsReady(false),
+    dirty(false),
+    dirtySince(0) {}
+
+/**
+ * @brief Registers a setting with its default value and valid range.
+ *
+ * @param key Setting name, as used in the config JSON.
+ * @param defaultValue Compiled-in default.
+ * @param minValue Smallest accepted override.
+ * @param maxValue Largest accepted override.
+ * @return Setting ID for get(), or -1 if the table is full.
+ */
+int8_t ConfigStore::define(
+  const char* key,
+  uint32_t defaultValue,
+  uint32_t minValue,
+  uint32_t maxValue
+) {
+  if (count >= MAX_ENTRIES) {
+    Serial.println("ConfigStore: table full");
+    return -1;
+  }
+
+  entries[count].key      = key;
+  entries[count].value    = defaultValue;
+  entries[count].minValue = minValue;
+  entries[count].maxValue = maxValue;
+
+  return (int8_t)count++;
+}
+
+/**
+ * @brief Mounts LittleFS and applies persisted overrides.
+ *
+ * @return true if the filesystem is available, false otherwise.
+ */
+bool ConfigStore::begin() {
+
+  fsReady = LittleFS.begin();
+
+  if (!fsReady) {
+    Serial.println("ConfigStore: LittleFS mount failed");
+    return false;
+  }
+
+  File f = LittleFS.open(CONFIG_FILE, "r");
+
+  // No persisted overrides yet: keep compiled-in defaults
+  if (!f) return true;
+
+  StaticJsonDocument<512> doc;
+  DeserializationError err = deserializeJson(doc, f);
+  f.close();
+
+  if (err) {
+    Serial.print("ConfigStore: persisted config unreadable: ");
+    Serial.println(err.c_str());
+    return true;
+  }
+
+  uint8_t applied = applyJson(doc);
+  dirty = false;  // What we just loaded is already on flash
+
+  Serial.printf("ConfigStore: %u persisted overrides applied\n", applied);
+  return true;
+}
+
+/**
+ * @brief Returns the current value of a setting.
+ *
+ * @param id Setting ID returned by define().
+ * @return Current value, or 0 for an invalid ID.
+ */
+uint32_t ConfigStore::get(int8_t id) const {
+  if (id < 0 || id >= (int8_t)count) return 0;
+  return entries[id].value;
+}
+
+/**
+ * @brief Applies overrides from a config JSON document.
+ *
+ * @param doc Parsed config document (flat key/value object).
+ * @return Number of settings that changed.
+ */
+uint8_t ConfigStore::applyJson(const JsonDocument& doc) {
+  uint8_t changed = 0;
+
+  for (uint8_t i = 0; i < count; i++) {
+    JsonVariantConst field = doc[entries[i].key];
+
+    // Key absent from this config message
+    if (field.isNull()) continue;
+
+    // Reject non-numeric values outright
+    if (!field.is<uint32_t>()) {
+      Serial.printf("ConfigStore: %s rejected (not a number)\n",
+                    entries[i].key);
+      continue;
+    }
+
+    uint32_t value = field.as<uint32_t>();
+
+    // Range validation
+    if (value < entries[i].minValue || value > entries[i].maxValue) {
+      Serial.printf("ConfigStore: %s rejected (%lu outside %lu..%lu)\n",
+                    entries[i].key,
+                    (unsigned long)value,
+                    (unsigned long)entries[i].minValue,
+                    (unsigned long)entries[i].maxValue);
+      continue;
+    }
+
+    if (entries[i].value != value) {
+      Serial.printf("ConfigStore: %s = %lu\n",
+                    entries[i].key, (unsigned long)value);
+      entries[i].value = value;
+      changed++;
+    }
+  }
+
+  if (changed > 0) {
+    dirty = true;
+    dirtySince = millis();
+  }
+
+  return changed;
+}
+
+/**
+ * @brief Persists pending changes to flash.
+ */
+void ConfigStore::loop() {
+  if (!dirty || !fsReady) return;
+
+  // Wait out the debounce window before touching flash
+  if ((int32_t)(millis() - (dirtySince + SAVE_DEBOUNCE_MS)) < 0) return;
+
+  save();
+  dirty = false;
+}
+
+/**
+ * @brief Writes all current values to the LittleFS config file.
+ */
+void ConfigStore::save() {
+  StaticJsonDocument<512> doc;
+
+  for (uint8_t i = 0; i < count; i++) {
+    doc[entries[i].key] = entries[i].value;
+  }
+
+  File f = LittleFS.open(CONFIG_FILE, "w");
+
+  if (!f) {
+    Serial.println("ConfigStore: save failed");
+    return;
+  }
+
+  serializeJson(doc, f);
+  f.close();
+}
@@ -0,0 +1,131 @@
+/**
+ * @file ConfigStore.h
+ * @brief Runtime-tunable configuration with MQTT delivery and flash persistence.
+ *
+ * @ingroup infrastructure
+ *
+ * @details
+ * This header defines the ConfigStore class, which replaces compiled-in
+ * timing constants with runtime-tunable values:
+ *
+ * - Defaults are registered in code with define(), including a valid range
+ * - Overrides arrive as a retained JSON message on the "<base>/config"
+ *   topic and are validated and applied live
+ * - Applied overrides are persisted to LittleFS, so they are available
+ *   immediately on the next boot without waiting for the broker
+ *
+ * Values that cannot be applied live (WiFi/MQTT credentials, which are
+ * needed before any MQTT message can arrive) stay compiled in.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+/**
+ * @class ConfigStore
+ * @brief Fixed table of named uint32 settings with ranges and persistence.
+ *
+ * Typical usage:
+ * @code
+ *   ConfigStore cfg;
+ *   int8_t cfgPinTime = cfg.define("pin_time_ms", 15000, 1000, 60000);
+ *   cfg.begin();                    // load persisted overrides
+ *   ...
+ *   showTextUntil = millis() + cfg.get(cfgPinTime);
+ *   ...
+ *   cfg.applyJson(doc);             // from the retained config message
+ *   cfg.loop();                     // debounced flash persistence
+ * @endcode
+ */
+class ConfigStore {
+public:
+  /** @brief Maximum number of defined settings. */
+  static constexpr uint8_t MAX_ENTRIES = 8;
+
+  /** @brief Constructs an empty store. */
+  ConfigStore();
+
+  /**
+   * @brief Registers a setting with its default value and valid range.
+   *
+   * Must be called for all settings before begin().
+   *
+   * @param key Setting name, as used in the config JSON (string literal).
+   * @param defaultValue Compiled-in default.
+   * @param minValue Smallest accepted override.
+   * @param maxValue Largest accepted override.
+   * @return Setting ID for get(), or -1 if the table is full.
+   */
+  int8_t define(
+    const char* key,
+    uint32_t defaultValue,
+    uint32_t minValue,
+    uint32_t maxValue
+  );
+
+  /**
+   * @brief Mounts LittleFS and applies persisted overrides.
+   *
+   * Call after all define() calls. Missing or invalid persisted values
+   * leave the compiled-in defaults in place.
+   *
+   * @return true if the filesystem is available, false otherwise.
+   */
+  bool begin();
+
+  /**
+   * @brief Returns the current value of a setting.
+   *
+   * @param id Setting ID returned by define().
+   * @return Current value, or 0 for an invalid ID.
+   */
+  uint32_t get(int8_t id) const;
+
+  /**
+   * @brief Applies overrides from a config JSON document.
+   *
+   * Each defined key present in the document is range-checked and
+   * applied; out-of-range or wrong-typed values are rejected with a
+   * Serial warning. Accepted changes are scheduled for persistence.
+   *
+   * @param doc Parsed config document (flat key/value object).
+   * @return Number of settings that changed.
+   */
+  uint8_t applyJson(const JsonDocument& doc);
+
+  /**
+   * @brief Persists pending changes to flash.
+   *
+   * Writes are debounced; call frequently from the Arduino loop().
+   */
+  void loop();
+
+private:
+  /** @brief Writes all current values to the LittleFS config file. */
+  void save();
+
+  /** @brief One defined setting. */
+  struct Entry {
+    const char* key;      /**< Setting name */
+    uint32_t value;       /**< Current value */
+    uint32_t minValue;    /**< Smallest accepted override */
+    uint32_t maxValue;    /**< Largest accepted override */
+  };
+
+  /** @brief Defined settings table. */
+  Entry entries[MAX_ENTRIES];
+
+  /** @brief Number of defined settings. */
+  uint8_t count;
+
+  /** @brief Indicates whether LittleFS mounted successfully. */
+  bool fsReady;
+
+  /** @brief Indicates unsaved changes. */
+  bool dirty;
+
+  /** @brief Timestamp (ms) of the last accepted change. */
+  uint32_t dirtySince;
+};
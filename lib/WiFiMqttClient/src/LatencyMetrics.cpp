@@ -0,0 +1,159 @@
+/**
+ * @file LatencyMetrics.cpp
+ * @brief Implementation of the LatencyMetrics instrumentation class.
+ *
+ * @ingroup infrastructure
+ */
+
+#include "LatencyMetrics.h"
+
+/**
+ * @brief Short stage names used as JSON keys in the published summary.
+ *
+ * Order must match the LatencyStage enumeration.
+ */
+static const char* const STAGE_NAMES[(uint8_t)LatencyStage::Count] = {
+  "card_to_pub",
+  "pub_to_resp",
+  "resp_to_lcd",
+  "key_to_pub",
+  "cmd_to_servo"
+};
+
+/**
+ * @brief Constructs an empty metrics table.
+ */
+LatencyMetrics::LatencyMetrics()
+  : nextPublish(0) {
+  memset(histogram, 0, sizeof(histogram));
+  memset(samples, 0, sizeof(samples));
+  memset(maxMs, 0, sizeof(maxMs));
+  memset(startedAt, 0, sizeof(startedAt));
+}
+
+/**
+ * @brief Marks the start of a stage interval.
+ *
+ * @param stage Stage being timed.
+ */
+void LatencyMetrics::stageStart(LatencyStage stage) {
+  // Use 1 when millis() happens to be 0 so "pending" stays detectable
+  uint32_t now = millis();
+  startedAt[(uint8_t)stage] = (now != 0) ? now : 1;
+}
+
+/**
+ * @brief Marks the end of a stage interval and records the duration.
+ *
+ * @param stage Stage being timed.
+ */
+void LatencyMetrics::stageEnd(LatencyStage stage) {
+  const uint8_t index = (uint8_t)stage;
+
+  // No matching stageStart(): nothing to record
+  if (startedAt[index] == 0) return;
+
+  record(stage, millis() - startedAt[index]);
+  startedAt[index] = 0;
+}
+
+/**
+ * @brief Records an already-measured stage duration.
+ *
+ * @param stage Stage the sample belongs to.
+ * @param durationMs Measured duration in milliseconds.
+ */
+void LatencyMetrics::record(LatencyStage stage, uint32_t durationMs) {
+  const uint8_t index = (uint8_t)stage;
+
+  // Saturating bucket count to survive long aggregation windows
+  uint16_t& bucket = histogram[index][bucketFor(durationMs)];
+  if (bucket < 0xFFFF) bucket++;
+
+  if (samples[index] < 0xFFFF) samples[index]++;
+
+  if (durationMs > maxMs[index]) {
+    maxMs[index] = durationMs;
+  }
+}
+
+/**
+ * @brief Maps a duration to its histogram bucket index.
+ *
+ * @param durationMs Duration in milliseconds.
+ * @return Bucket index (0..BUCKETS-1).
+ */
+uint8_t LatencyMetrics::bucketFor(uint32_t durationMs) {
+  uint8_t bucket = 0;
+
+  while (durationMs > 1 && bucket < BUCKETS - 1) {
+    durationMs >>= 1;
+    bucket++;
+  }
+
+  return bucket;
+}
+
+/**
+ * @brief Estimates a percentile from a stage's histogram.
+ *
+ * @param stage Stage index.
+ * @param percent Percentile (0..100).
+ * @return Estimated duration in milliseconds.
+ */
+uint32_t LatencyMetrics::percentile(uint8_t stage, uint8_t percent) const {
+  if (samples[stage] == 0) return 0;
+
+  // Rank of the requested sample (1-based, rounded up)
+  uint32_t rank = ((uint32_t)samples[stage] * percent + 99) / 100;
+  uint32_t seen = 0;
+
+  for (uint8_t bucket = 0; bucket < BUCKETS; bucket++) {
+    seen += histogram[stage][bucket];
+
+    if (seen >= rank) {
+      // Upper bound of this bucket: 2^(bucket+1) ms
+      return (uint32_t)1 << (bucket + 1);
+    }
+  }
+
+  return maxMs[stage];
+}
+
+/**
+ * @brief Publishes the summary when due and resets the histograms.
+ *
+ * @param net Network client used for publishing.
+ */
+void LatencyMetrics::loop(WifiMqttClient& net) {
+  const uint32_t now = millis();
+
+  if ((int32_t)(now - nextPublish) < 0) return;
+  nextPublish = now + PUBLISH_INTERVAL_MS;
+
+  // Skip the publish entirely when no stage has samples
+  bool anySamples = false;
+  for (uint8_t i = 0; i < (uint8_t)LatencyStage::Count; i++) {
+    if (samples[i] > 0) anySamples = true;
+  }
+  if (!anySamples) return;
+
+  StaticJsonDocument<384> data;
+
+  for (uint8_t i = 0; i < (uint8_t)LatencyStage::Count; i++) {
+    if (samples[i] == 0) continue;
+
+    JsonObject stage = data.createNestedObject(STAGE_NAMES[i]);
+    stage["n"]   = samples[i];
+    stage["p50"] = percentile(i, 50);
+    stage["p99"] = percentile(i, 99);
+    stage["max"] = maxMs[i];
+  }
+
+  net.publishJson("metrics/latency", data);
+
+  // Start a fresh aggregation window
+  memset(histogram, 0, sizeof(histogram));
+  memset(samples, 0, sizeof(samples));
+  memset(maxMs, 0, sizeof(maxMs));
+}
@@ -0,0 +1,133 @@
+/**
+ * @file LatencyMetrics.h
+ * @brief On-device latency instrumentation with fixed-size histograms.
+ *
+ * @ingroup infrastructure
+ *
+ * @details
+ * This header defines the LatencyMetrics class, which timestamps the
+ * latency-critical stages of the access flow, aggregates the measured
+ * durations into power-of-two histograms in RAM, and periodically
+ * publishes a compact summary on the "metrics/latency" topic.
+ *
+ * A stage is measured either with stageStart()/stageEnd() around the
+ * interval, or by passing an already-computed duration to record().
+ * Everything is fixed-size; recording a sample costs a few arithmetic
+ * operations and no allocation.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include "WiFiMqttClient.h"
+
+/**
+ * @brief Instrumented stages of the access flow.
+ */
+enum class LatencyStage : uint8_t {
+  CardToPublish,      /**< Card read complete -> access request published */
+  PublishToResponse,  /**< Access request published -> response received */
+  ResponseToLcd,      /**< Response received -> LCD updated */
+  KeyToPublish,       /**< Key event dequeued -> tap/submit published */
+  CommandToServo,     /**< MQTT command received -> servo target reached */
+  Count               /**< Number of stages (table size, not a stage) */
+};
+
+/**
+ * @class LatencyMetrics
+ * @brief Fixed-size per-stage latency histograms with periodic publishing.
+ *
+ * Typical usage:
+ * @code
+ *   LatencyMetrics metrics;
+ *   metrics.stageStart(LatencyStage::CardToPublish);
+ *   ...
+ *   metrics.stageEnd(LatencyStage::CardToPublish);
+ *   metrics.loop(net);   // called from loop(); publishes every 60 s
+ * @endcode
+ */
+class LatencyMetrics {
+public:
+  /** @brief Number of histogram buckets (power-of-two bounds). */
+  static constexpr uint8_t BUCKETS = 16;
+
+  /** @brief Interval (ms) between published summaries. */
+  static constexpr uint32_t PUBLISH_INTERVAL_MS = 60000;
+
+  /** @brief Constructs an empty metrics table. */
+  LatencyMetrics();
+
+  /**
+   * @brief Marks the start of a stage interval.
+   *
+   * @param stage Stage being timed.
+   */
+  void stageStart(LatencyStage stage);
+
+  /**
+   * @brief Marks the end of a stage interval and records the duration.
+   *
+   * Ignored when no matching stageStart() is pending.
+   *
+   * @param stage Stage being timed.
+   */
+  void stageEnd(LatencyStage stage);
+
+  /**
+   * @brief Records an already-measured stage duration.
+   *
+   * @param stage Stage the sample belongs to.
+   * @param durationMs Measured duration in milliseconds.
+   */
+  void record(LatencyStage stage, uint32_t durationMs);
+
+  /**
+   * @brief Publishes the summary when due and resets the histograms.
+   *
+   * Must be called frequently from the Arduino loop(). Publishes at
+   * most once per PUBLISH_INTERVAL_MS, and only for stages that have
+   * samples.
+   *
+   * @param net Network client used for publishing.
+   */
+  void loop(WifiMqttClient& net);
+
+private:
+  /**
+   * @brief Maps a duration to its histogram bucket index.
+   *
+   * Bucket i covers durations in [2^i, 2^(i+1)) ms, with bucket 0
+   * also covering sub-millisecond samples.
+   *
+   * @param durationMs Duration in milliseconds.
+   * @return Bucket index (0..BUCKETS-1).
+   */
+  static uint8_t bucketFor(uint32_t durationMs);
+
+  /**
+   * @brief Estimates a percentile from a stage's histogram.
+   *
+   * Returns the upper bound of the bucket containing the requested
+   * rank, which over-reports by at most one bucket width.
+   *
+   * @param stage Stage index.
+   * @param percent Percentile (0..100).
+   * @return Estimated duration in milliseconds.
+   */
+  uint32_t percentile(uint8_t stage, uint8_t percent) const;
+
+  /** @brief Per-stage histogram bucket counts. */
+  uint16_t histogram[(uint8_t)LatencyStage::Count][BUCKETS];
+
+  /** @brief Per-stage sample counts. */
+  uint16_t samples[(uint8_t)LatencyStage::Count];
+
+  /** @brief Per-stage maximum observed duration (ms). */
+  uint32_t maxMs[(uint8_t)LatencyStage::Count];
+
+  /** @brief Per-stage pending stageStart() timestamps (0 = none). */
+  uint32_t startedAt[(uint8_t)LatencyStage::Count];
+
+  /** @brief Timestamp (ms) of the next summary publish. */
+  uint32_t nextPublish;
+};
@@ -0,0 +1,224 @@
+/**
+ * @file OtaUpdater.cpp
+ * @brief Implementation of the chunked MQTT OTA transfer.
+ *
+ * @ingroup infrastructure
+ */
+
+#include "OtaUpdater.h"
+#include "WiFiMqttClient.h"
+#include <Updater.h>
+
+/**
+ * @brief Default constructor.
+ */
+OtaUpdater::OtaUpdater()
+  : client(nullptr),
+    currentVersion(""),
+    imageSize(0),
+    offset(0),
+    chunkDeadline(0),
+    retries(0),
+    lastReported(0),
+    downloading(false) {
+  targetVersion[0] = '\0';
+}
+
+/**
+ * @brief Binds the updater to the MQTT client and running version.
+ *
+ * @param client MQTT client used for requests and status reports.
+ * @param currentVersion Version string of the running firmware.
+ */
+void OtaUpdater::begin(WifiMqttClient& client, const char* currentVersion) {
+  this->client = &client;
+  this->currentVersion = currentVersion;
+}
+
+/**
+ * @brief Handles a firmware announcement from the manifest topic.
+ *
+ * @param doc Parsed manifest document.
+ */
+void OtaUpdater::handleManifest(const JsonDocument& doc) {
+  if (client == nullptr) return;
+
+  const char* version = doc["version"] | (const char*)nullptr;
+  const uint32_t size = doc["size"] | 0;
+  const char* md5     = doc["md5"] | (const char*)nullptr;
+
+  if (version == nullptr || size == 0 || md5 == nullptr) {
+    Serial.println("OTA: malformed manifest, ignoring");
+    return;
+  }
+
+  // The manifest is retained, so every node sees it on connect;
+  // nodes already running the announced version stay quiet
+  if (strcmp(version, currentVersion) == 0) return;
+
+  // A manifest received mid-transfer is ignored; the new version is
+  // picked up from the retained topic after the current attempt ends
+  if (downloading) return;
+
+  // Reserve the spare flash region for the incoming image
+  if (!Update.begin(size)) {
+    Update.printError(Serial);
+    abortUpdate("begin failed");
+    return;
+  }
+  Update.setMD5(md5);
+
+  strlcpy(targetVersion, version, sizeof(targetVersion));
+  imageSize    = size;
+  offset       = 0;
+  retries      = 0;
+  lastReported = 0;
+  downloading  = true;
+
+  Serial.printf("OTA: %s -> %s, %lu bytes\n",
+                currentVersion, targetVersion, (unsigned long)imageSize);
+
+  publishStatus("start");
+  requestChunk();
+}
+
+/**
+ * @brief Handles a binary firmware chunk from the chunk topic.
+ *
+ * @param payload Raw chunk bytes.
+ * @param length Chunk length including the offset header.
+ */
+void OtaUpdater::handleChunk(const uint8_t* payload, size_t length) {
+  if (!downloading || length <= 4) return;
+
+  // 4-byte little-endian image offset precedes the image bytes
+  uint32_t chunkOffset;
+  memcpy(&chunkOffset, payload, 4);
+
+  // Duplicates and stale retransmits are discarded; stop-and-wait
+  // means only the chunk at the expected offset advances the image
+  if (chunkOffset != offset) {
+    requestChunk();
+    return;
+  }
+
+  const uint8_t* data = payload + 4;
+  const size_t dataLen = length - 4;
+
+  if (Update.write(const_cast<uint8_t*>(data), dataLen) != dataLen) {
+    Update.printError(Serial);
+    abortUpdate("write failed");
+    return;
+  }
+
+  offset += dataLen;
+  retries = 0;
+
+  // Progress report roughly every 10% of the image
+  if (offset - lastReported >= imageSize / 10) {
+    lastReported = offset;
+    Serial.printf("OTA: %lu/%lu bytes\n",
+                  (unsigned long)offset, (unsigned long)imageSize);
+    publishStatus("progress");
+  }
+
+  if (offset < imageSize) {
+    requestChunk();
+    return;
+  }
+
+  // Whole image received: verify the MD5 and commit
+  if (!Update.end()) {
+    Update.printError(Serial);
+    abortUpdate("verify failed");
+    return;
+  }
+
+  downloading = false;
+  publishStatus("done");
+  Serial.printf("OTA: %s verified, rebooting\n", targetVersion);
+
+  delay(250);  // Let the status publish leave the socket
+  ESP.restart();
+}
+
+/**
+ * @brief Timeout service; call regularly from the scheduler.
+ */
+void OtaUpdater::loop() {
+  if (!downloading) return;
+
+  if ((int32_t)(millis() - chunkDeadline) < 0) return;
+
+  // Chunk overdue: a drop or disconnect ate the request or the reply.
+  // Re-requesting resumes the transfer at the expected offset; the
+  // publish is queued if the broker is still unreachable.
+  if (retries >= MAX_RETRIES) {
+    abortUpdate("timeout");
+    return;
+  }
+
+  retries++;
+  Serial.printf("OTA: chunk timeout at %lu, re-requesting (%u/%u)\n",
+                (unsigned long)offset, retries, MAX_RETRIES);
+  requestChunk();
+}
+
+/**
+ * @brief Checks whether a firmware transfer is in progress.
+ *
+ * @return true while a transfer is active, false otherwise.
+ */
+bool OtaUpdater::active() const {
+  return downloading;
+}
+
+/**
+ * @brief Requests the chunk at the expected offset and arms the timeout.
+ */
+void OtaUpdater::requestChunk() {
+  StaticJsonDocument<128> data;
+  data["version"] = targetVersion;
+  data["offset"]  = offset;
+  data["length"]  = (uint32_t)CHUNK_SIZE;
+
+  client->publishJson("ota/request", data);
+  chunkDeadline = millis() + CHUNK_TIMEOUT_MS;
+}
+
+/**
+ * @brief Publishes a status report on the "ota/status" topic.
+ *
+ * @param state Status string ("start", "progress", "done", "failed").
+ */
+void OtaUpdater::publishStatus(const char* state) {
+  StaticJsonDocument<192> data;
+  data["state"]   = state;
+  data["version"] = targetVersion;
+  data["offset"]  = offset;
+  data["size"]    = imageSize;
+
+  client->publishJson("ota/status", data);
+}
+
+/**
+ * @brief Aborts the transfer and reports the failure.
+ *
+ * @param reason Short failure description for the status report.
+ */
+void OtaUpdater::abortUpdate(const char* reason) {
+  Serial.printf("OTA: aborted (%s)\n", reason);
+
+  if (downloading) {
+    Update.end();  // Release the flash region
+  }
+  downloading = false;
+
+  StaticJsonDocument<192> data;
+  data["state"]   = "failed";
+  data["reason"]  = reason;
+  data["version"] = targetVersion;
+  data["offset"]  = offset;
+
+  client->publishJson("ota/status", data);
+}
@@ -0,0 +1,159 @@
+/**
+ * @file OtaUpdater.h
+ * @brief Chunked, resumable over-the-air firmware updates via MQTT.
+ *
+ * @ingroup infrastructure
+ *
+ * @details
+ * This header defines the OtaUpdater class, which pulls a new firmware
+ * image through the existing broker connection instead of requiring a
+ * serial flash at each site:
+ * - An update is announced on the "ota/manifest" topic (version, size,
+ *   MD5); nodes already running that version ignore it.
+ * - The image is fetched in small stop-and-wait chunks requested on
+ *   "ota/request" and delivered on "ota/chunk", so the transfer never
+ *   monopolizes the broker connection the access path depends on.
+ * - A broker or WiFi outage mid-transfer pauses the download; the next
+ *   chunk request is simply re-issued once the connection recovers, so
+ *   the transfer resumes where it stopped instead of restarting.
+ * - The image is written to the spare OTA flash region via the ESP8266
+ *   Updater and applied with a reboot. LittleFS is untouched, so the
+ *   persisted config and UID cache survive and the door returns to
+ *   service with its cached state intact.
+ *
+ * A transfer interrupted by a reboot restarts from offset zero on the
+ * next manifest: the Updater cannot re-enter a half-written image.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+class WifiMqttClient;
+
+/**
+ * @class OtaUpdater
+ * @brief Pull-based OTA firmware transfer over the MQTT connection.
+ *
+ * The sketch wires three points: handleManifest() for JSON messages on
+ * the manifest topic, handleChunk() for binary messages on the chunk
+ * topic, and loop() from the scheduler for timeout-driven resume.
+ */
+class OtaUpdater {
+public:
+  /** @brief Payload bytes requested per chunk (fits the MQTT buffer). */
+  static constexpr size_t CHUNK_SIZE = 512;
+
+  /** @brief Time (ms) to wait for a chunk before re-requesting it. */
+  static constexpr uint32_t CHUNK_TIMEOUT_MS = 5000;
+
+  /** @brief Re-requests of the same chunk before the update is aborted. */
+  static constexpr uint8_t MAX_RETRIES = 20;
+
+  /**
+   * @brief Default constructor.
+   */
+  OtaUpdater();
+
+  /**
+   * @brief Binds the updater to the MQTT client and running version.
+   *
+   * @param client MQTT client used for requests and status reports.
+   * @param currentVersion Version string of the running firmware.
+   */
+  void begin(WifiMqttClient& client, const char* currentVersion);
+
+  /**
+   * @brief Handles a firmware announcement from the manifest topic.
+   *
+   * Starts a transfer when the announced version differs from the
+   * running one; announcements for the running version, or received
+   * mid-transfer, are ignored.
+   *
+   * Expected fields: "version" (string), "size" (bytes), "md5"
+   * (hex digest of the full image).
+   *
+   * @param doc Parsed manifest document.
+   */
+  void handleManifest(const JsonDocument& doc);
+
+  /**
+   * @brief Handles a binary firmware chunk from the chunk topic.
+   *
+   * Chunk layout: 4-byte little-endian image offset followed by the
+   * raw image bytes. Chunks for any offset other than the expected one
+   * (duplicates, stale retransmits) are discarded and the expected
+   * chunk is re-requested.
+   *
+   * @param payload Raw chunk bytes.
+   * @param length Chunk length including the offset header.
+   */
+  void handleChunk(const uint8_t* payload, size_t length);
+
+  /**
+   * @brief Timeout service; call regularly from the scheduler.
+   *
+   * Re-requests the expected chunk when the wait times out — this is
+   * what resumes a transfer after a disconnect, since the request is
+   * queued for delivery once the connection recovers.
+   */
+  void loop();
+
+  /**
+   * @brief Checks whether a firmware transfer is in progress.
+   *
+   * Sketches use this to hold off power-save modes that would drop
+   * the network mid-transfer.
+   *
+   * @return true while a transfer is active, false otherwise.
+   */
+  bool active() const;
+
+private:
+  /**
+   * @brief Publishes a status report on the "ota/status" topic.
+   *
+   * @param state Status string ("start", "progress", "done", "failed").
+   */
+  void publishStatus(const char* state);
+
+  /**
+   * @brief Requests the chunk at the expected offset and arms the timeout.
+   */
+  void requestChunk();
+
+  /**
+   * @brief Aborts the transfer and reports the failure.
+   *
+   * @param reason Short failure description for the status report.
+   */
+  void abortUpdate(const char* reason);
+
+  /** @brief MQTT client used for requests and status reports. */
+  WifiMqttClient* client;
+
+  /** @brief Version string of the running firmware. */
+  const char* currentVersion;
+
+  /** @brief Version string of the image being transferred. */
+  char targetVersion[16];
+
+  /** @brief Total image size (bytes). */
+  uint32_t imageSize;
+
+  /** @brief Next image offset expected from the chunk topic. */
+  uint32_t offset;
+
+  /** @brief Deadline (ms) for the outstanding chunk request. */
+  uint32_t chunkDeadline;
+
+  /** @brief Re-requests issued for the current chunk. */
+  uint8_t retries;
+
+  /** @brief Image offset of the last progress report. */
+  uint32_t lastReported;
+
+  /** @brief Indicates whether a transfer is in progress. */
+  bool downloading;
+};
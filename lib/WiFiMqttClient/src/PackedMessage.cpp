@@ -0,0 +1,230 @@
+/**
+ * @file PackedMessage.cpp
+ * @brief Implementation of the packed binary frame writer and reader.
+ *
+ * @ingroup infrastructure
+ */
+
+#include "PackedMessage.h"
+
+// -----------------------------------------------------------------------------
+// PackedWriter
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Constructs an empty writer.
+ */
+PackedWriter::PackedWriter()
+  : length(0) {}
+
+/**
+ * @brief Starts a new frame and writes the fixed header.
+ *
+ * @param event Event type code.
+ * @param chipId Chip identifier of the sending device.
+ */
+void PackedWriter::begin(PackedEvent event, uint32_t chipId) {
+  const uint32_t now = millis();
+
+  buffer[0] = PACKED_MAGIC;
+  buffer[1] = (uint8_t)event;
+
+  memcpy(&buffer[2], &chipId, 4);
+  memcpy(&buffer[6], &now, 4);
+
+  length = PACKED_HEADER_LEN;
+}
+
+/**
+ * @brief Appends a raw TLV record.
+ *
+ * @param tag TLV tag.
+ * @param value Value bytes.
+ * @param valueLength Value length.
+ * @return true if the record fit in the frame, false otherwise.
+ */
+bool PackedWriter::addTlv(PackedTag tag, const void* value, uint8_t valueLength) {
+
+  // Refuse records that would overflow the frame buffer
+  if (length + 2 + valueLength > PACKED_FRAME_MAX) {
+    return false;
+  }
+
+  buffer[length++] = (uint8_t)tag;
+  buffer[length++] = valueLength;
+
+  memcpy(&buffer[length], value, valueLength);
+  length += valueLength;
+
+  return true;
+}
+
+/**
+ * @brief Appends a string TLV record (terminator not included).
+ *
+ * @param tag TLV tag.
+ * @param value Null-terminated string.
+ * @return true if the record fit in the frame, false otherwise.
+ */
+bool PackedWriter::addString(PackedTag tag, const char* value) {
+  size_t len = strlen(value);
+
+  // TLV length field is a single byte
+  if (len > 255) return false;
+
+  return addTlv(tag, value, (uint8_t)len);
+}
+
+/**
+ * @brief Appends a single-byte TLV record.
+ *
+ * @param tag TLV tag.
+ * @param value Byte value.
+ * @return true if the record fit in the frame, false otherwise.
+ */
+bool PackedWriter::addU8(PackedTag tag, uint8_t value) {
+  return addTlv(tag, &value, 1);
+}
+
+/**
+ * @brief Returns a pointer to the composed frame.
+ */
+const uint8_t* PackedWriter::data() const {
+  return buffer;
+}
+
+/**
+ * @brief Returns the composed frame length in bytes.
+ */
+size_t PackedWriter::size() const {
+  return length;
+}
+
+// -----------------------------------------------------------------------------
+// PackedReader
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Attaches the reader to a received payload.
+ *
+ * @param payload Raw payload bytes.
+ * @param payloadLength Payload length.
+ */
+PackedReader::PackedReader(const uint8_t* payload, size_t payloadLength)
+  : payload(payload),
+    payloadLength(payloadLength) {}
+
+/**
+ * @brief Checks whether the payload is a well-formed packed frame.
+ */
+bool PackedReader::valid() const {
+  return payloadLength >= PACKED_HEADER_LEN &&
+         payload[0] == PACKED_MAGIC;
+}
+
+/**
+ * @brief Checks whether a payload starts like a packed frame.
+ *
+ * @param payload Raw payload bytes.
+ * @param payloadLength Payload length.
+ * @return true if the payload carries the packed magic byte.
+ */
+bool PackedReader::isPacked(const uint8_t* payload, size_t payloadLength) {
+  return payloadLength >= 1 && payload[0] == PACKED_MAGIC;
+}
+
+/**
+ * @brief Returns the event type from the header.
+ */
+PackedEvent PackedReader::event() const {
+  return (PackedEvent)payload[1];
+}
+
+/**
+ * @brief Returns the sender chip ID from the header.
+ */
+uint32_t PackedReader::chipId() const {
+  uint32_t value;
+  memcpy(&value, &payload[2], 4);
+  return value;
+}
+
+/**
+ * @brief Returns the sender timestamp (ms) from the header.
+ */
+uint32_t PackedReader::timestamp() const {
+  uint32_t value;
+  memcpy(&value, &payload[6], 4);
+  return value;
+}
+
+/**
+ * @brief Finds a TLV record by tag.
+ *
+ * Linear scan over the TLV region; records with lengths that run
+ * past the payload end the scan.
+ *
+ * @param tag TLV tag to search for.
+ * @param lengthOut Receives the value length; may be nullptr.
+ * @return Pointer to the value bytes, or nullptr if absent.
+ */
+const uint8_t* PackedReader::find(PackedTag tag, uint8_t* lengthOut) const {
+  if (!valid()) return nullptr;
+
+  size_t offset = PACKED_HEADER_LEN;
+
+  while (offset + 2 <= payloadLength) {
+    const uint8_t recordTag = payload[offset];
+    const uint8_t recordLen = payload[offset + 1];
+
+    // Truncated record: stop scanning
+    if (offset + 2 + recordLen > payloadLength) break;
+
+    if (recordTag == (uint8_t)tag) {
+      if (lengthOut != nullptr) *lengthOut = recordLen;
+      return &payload[offset + 2];
+    }
+
+    offset += 2 + recordLen;
+  }
+
+  return nullptr;
+}
+
+/**
+ * @brief Reads a single-byte TLV value.
+ *
+ * @param tag TLV tag.
+ * @param fallback Value returned when the tag is absent.
+ * @return Value byte, or fallback.
+ */
+uint8_t PackedReader::readU8(PackedTag tag, uint8_t fallback) const {
+  uint8_t len = 0;
+  const uint8_t* value = find(tag, &len);
+
+  if (value == nullptr || len < 1) return fallback;
+  return value[0];
+}
+
+/**
+ * @brief Copies a string TLV value into a caller buffer.
+ *
+ * @param tag TLV tag.
+ * @param out Destination buffer.
+ * @param outSize Destination buffer size.
+ * @return true if the tag was present, false otherwise.
+ */
+bool PackedReader::readString(PackedTag tag, char* out, size_t outSize) const {
+  uint8_t len = 0;
+  const uint8_t* value = find(tag, &len);
+
+  if (value == nullptr || outSize == 0) {
+    if (outSize > 0) out[0] = '\0';
+    return false;
+  }
+
+  size_t copy = (len < outSize - 1) ? len : outSize - 1;
+  memcpy(out, value, copy);
+  out[copy] = '\0';
+  return true;
+}
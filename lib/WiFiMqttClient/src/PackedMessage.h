@@ -0,0 +1,218 @@
+/**
+ * @file PackedMessage.h
+ * @brief Compact binary wire format for latency-critical MQTT topics.
+ *
+ * @ingroup infrastructure
+ *
+ * @details
+ * This header defines a small binary codec used alongside the JSON
+ * envelope of publishJson(). A packed frame consists of:
+ *
+ *   - Fixed header (10 bytes):
+ *       magic (1) | event type (1) | chip ID (4) | timestamp ms (4)
+ *   - TLV payload: repeated [tag (1) | length (1) | value] records
+ *
+ * A frame for a UID plus a flag is ~20 bytes instead of the ~200-byte
+ * JSON envelope, and parsing is a linear scan with no allocation.
+ * Which topics carry packed frames is decided per topic by the
+ * sketches; JSON stays in place for everything Node-RED inspects.
+ * The magic byte lets a receive callback tell the two formats apart.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+/** @brief First byte of every packed frame. */
+constexpr uint8_t PACKED_MAGIC = 0xB1;
+
+/** @brief Size (bytes) of the fixed packed frame header. */
+constexpr size_t PACKED_HEADER_LEN = 10;
+
+/** @brief Maximum total size (bytes) of a packed frame. */
+constexpr size_t PACKED_FRAME_MAX = 128;
+
+/**
+ * @brief Event type codes carried in the packed frame header.
+ */
+enum class PackedEvent : uint8_t {
+  RfidTry     = 1,  /**< RFID scan, access request */
+  KeypadTap   = 2,  /**< Keypad keypress feedback */
+  KeypadTry   = 3,  /**< PIN submission */
+  Unlock      = 4,  /**< Door unlock command */
+  Status      = 5,  /**< Generic status report */
+  AuditBatch  = 6   /**< Batch of audit log records */
+};
+
+/**
+ * @brief TLV tags used in packed frame payloads.
+ */
+enum class PackedTag : uint8_t {
+  Uid       = 1,  /**< Card UID, hex string */
+  Flag      = 2,  /**< Boolean flag, 1 byte */
+  Count     = 3,  /**< Counter value, 1 byte */
+  Token     = 4,  /**< Opaque token bytes */
+  Text      = 5,  /**< Short text string */
+  State     = 6,  /**< Session state code, 1 byte */
+  Seq       = 7,  /**< Sequence number, 4 bytes little-endian */
+  Batch     = 8   /**< Concatenated fixed-size records */
+};
+
+/**
+ * @class PackedWriter
+ * @brief Composes a packed frame into a fixed internal buffer.
+ *
+ * Typical usage:
+ * @code
+ *   PackedWriter frame;
+ *   frame.begin(PackedEvent::RfidTry, chipId);
+ *   frame.addString(PackedTag::Uid, uidString);
+ *   net.publishPacked("access/request_bin", frame);
+ * @endcode
+ */
+class PackedWriter {
+public:
+  /** @brief Constructs an empty writer. */
+  PackedWriter();
+
+  /**
+   * @brief Starts a new frame and writes the fixed header.
+   *
+   * The timestamp field is stamped with millis().
+   *
+   * @param event Event type code.
+   * @param chipId Chip identifier of the sending device.
+   */
+  void begin(PackedEvent event, uint32_t chipId);
+
+  /**
+   * @brief Appends a raw TLV record.
+   *
+   * @param tag TLV tag.
+   * @param value Value bytes.
+   * @param length Value length (max 255 bytes).
+   * @return true if the record fit in the frame, false otherwise.
+   */
+  bool addTlv(PackedTag tag, const void* value, uint8_t length);
+
+  /**
+   * @brief Appends a string TLV record (terminator not included).
+   *
+   * @param tag TLV tag.
+   * @param value Null-terminated string.
+   * @return true if the record fit in the frame, false otherwise.
+   */
+  bool addString(PackedTag tag, const char* value);
+
+  /**
+   * @brief Appends a single-byte TLV record.
+   *
+   * @param tag TLV tag.
+   * @param value Byte value.
+   * @return true if the record fit in the frame, false otherwise.
+   */
+  bool addU8(PackedTag tag, uint8_t value);
+
+  /**
+   * @brief Returns a pointer to the composed frame.
+   *
+   * @return Frame bytes.
+   */
+  const uint8_t* data() const;
+
+  /**
+   * @brief Returns the composed frame length in bytes.
+   *
+   * @return Frame length.
+   */
+  size_t size() const;
+
+private:
+  /** @brief Frame composition buffer. */
+  uint8_t buffer[PACKED_FRAME_MAX];
+
+  /** @brief Current frame length in bytes. */
+  size_t length;
+};
+
+/**
+ * @class PackedReader
+ * @brief Parses a packed frame in place; no copy, no allocation.
+ *
+ * The reader points into the received payload buffer, so it must not
+ * outlive the MQTT callback invocation.
+ */
+class PackedReader {
+public:
+  /**
+   * @brief Attaches the reader to a received payload.
+   *
+   * @param payload Raw payload bytes.
+   * @param payloadLength Payload length.
+   */
+  PackedReader(const uint8_t* payload, size_t payloadLength);
+
+  /**
+   * @brief Checks whether the payload is a well-formed packed frame.
+   *
+   * @return true if the magic byte and header length check out.
+   */
+  bool valid() const;
+
+  /**
+   * @brief Checks whether a payload starts like a packed frame.
+   *
+   * Lets a shared MQTT callback route between binary and JSON.
+   *
+   * @param payload Raw payload bytes.
+   * @param payloadLength Payload length.
+   * @return true if the payload carries the packed magic byte.
+   */
+  static bool isPacked(const uint8_t* payload, size_t payloadLength);
+
+  /** @brief Returns the event type from the header. */
+  PackedEvent event() const;
+
+  /** @brief Returns the sender chip ID from the header. */
+  uint32_t chipId() const;
+
+  /** @brief Returns the sender timestamp (ms) from the header. */
+  uint32_t timestamp() const;
+
+  /**
+   * @brief Finds a TLV record by tag.
+   *
+   * @param tag TLV tag to search for.
+   * @param lengthOut Receives the value length; may be nullptr.
+   * @return Pointer to the value bytes, or nullptr if absent.
+   */
+  const uint8_t* find(PackedTag tag, uint8_t* lengthOut) const;
+
+  /**
+   * @brief Reads a single-byte TLV value.
+   *
+   * @param tag TLV tag.
+   * @param fallback Value returned when the tag is absent.
+   * @return Value byte, or fallback.
+   */
+  uint8_t readU8(PackedTag tag, uint8_t fallback) const;
+
+  /**
+   * @brief Copies a string TLV value into a caller buffer.
+   *
+   * The result is always null-terminated; overlong values are truncated.
+   *
+   * @param tag TLV tag.
+   * @param out Destination buffer.
+   * @param outSize Destination buffer size.
+   * @return true if the tag was present, false otherwise.
+   */
+  bool readString(PackedTag tag, char* out, size_t outSize) const;
+
+private:
+  /** @brief Received payload bytes (not owned). */
+  const uint8_t* payload;
+
+  /** @brief Payload length in bytes. */
+  size_t payloadLength;
+};
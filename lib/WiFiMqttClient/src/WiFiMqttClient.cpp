@@ -8,6 +8,8 @@
 
 #include "WiFiMqttClient.h"
 #include <ESP8266WiFi.h>
+#include <ESP8266mDNS.h>
+#include <LittleFS.h>
 // #include <esp_system.h>
 
 /**
@@ -17,13 +19,94 @@
  */
 static constexpr const char* DEVICE_NAME = "ESP8266";
 
+/** @brief Maximum time (ms) to wait for WiFi association before retrying. */
+static constexpr uint32_t WIFI_ATTEMPT_TIMEOUT_MS = 15000;
+
+/** @brief Initial MQTT reconnect backoff interval (ms). */
+static constexpr uint32_t BACKOFF_MIN_MS = 500;
+
+/** @brief Maximum MQTT reconnect backoff interval (ms). */
+static constexpr uint32_t BACKOFF_MAX_MS = 30000;
+
+/** @brief Failed connect attempts before switching brokers. */
+static constexpr uint8_t FAILOVER_ATTEMPTS = 2;
+
+/** @brief Interval (ms) between primary retries while on the fallback. */
+static constexpr uint32_t PRIMARY_RETRY_MS = 60000;
+
+/** @brief Path of the flash-backed publish queue log. */
+static constexpr const char* QUEUE_FILE = "/pubqueue.bin";
+
+/** @brief Maximum size (bytes) of the flash-backed publish queue log. */
+static constexpr size_t QUEUE_FILE_MAX = 16384;
+
 /**
  * @brief Default constructor.
  *
  * Initializes the PubSubClient instance with the internal WiFiClient.
  */
 WifiMqttClient::WifiMqttClient()
-  : mqtt(wifiClient) {}
+  : useTls(false),
+    mqtt(wifiClient),
+    fallbackHost(nullptr),
+    fallbackPort(0),
+    discoveredPort(0),
+    onFallback(false),
+    failedAttempts(0),
+    primaryRetryAt(0),
+    connState(ConnState::Idle),
+    wifiAttemptStart(0),
+    nextMqttAttempt(0),
+    backoffMs(BACKOFF_MIN_MS),
+    topicCount(0),
+    readyHandler(nullptr),
+    filterCount(0),
+    coalesceCount(0),
+    telemetryCount(0),
+    queueHead(0),
+    queueCount(0),
+    flashQueued(false),
+    flashReadOffset(0),
+    fsReady(false),
+    publishSeq(0),
+    seenIndex(0) {
+  memset(seenKeys, 0, sizeof(seenKeys));
+  memset(filterSlot, -1, sizeof(filterSlot));  // No filters registered
+  discoveredHost[0] = '\0';
+}
+
+/**
+ * @brief Switches the MQTT transport to TLS (BearSSL).
+ *
+ * Fingerprint pinning keeps the node free of a CA store and a real
+ * clock; the attached session object makes every reconnect after the
+ * first an abbreviated handshake. The reduced BearSSL buffers fit
+ * beside the 1 KB MQTT buffer; the broker must accept the MFLN
+ * extension for them to hold.
+ *
+ * @param fingerprintHex SHA-1 fingerprint of the broker certificate.
+ */
+void WifiMqttClient::enableTls(const char* fingerprintHex) {
+  tlsClient.setFingerprint(fingerprintHex);
+  tlsClient.setBufferSizes(1024, 1024);
+  tlsClient.setSession(&tlsSession);
+
+  mqtt.setClient(tlsClient);
+  useTls = true;
+
+  Serial.println("MQTT transport: TLS with session resumption");
+}
+
+/**
+ * @brief Registers an explicit fallback broker for LAN failover.
+ *
+ * @param host Fallback broker hostname or IP.
+ * @param port Fallback broker port.
+ */
+void WifiMqttClient::setFallbackBroker(const char* host, uint16_t port) {
+  fallbackHost = host;
+  fallbackPort = port;
+}
 
 /**
  * @brief Initializes WiFi and MQTT configuration.
@@ -62,9 +145,14 @@ void WifiMqttClient::begin(
 
   // Retrieve unique chip identifier for client ID generation
   chipId = ESP.getChipId();
+  snprintf(chipIdHex, sizeof(chipIdHex), "%x", (uint32_t)chipId);
 
-  // Construct base MQTT topic: <user>/<site>/<device>
-  baseTopic = String(mqttUser) + "/" + site + "/" + deviceId;
+  // Compose the base topic and client ID once into fixed buffers;
+  // nothing on the publish or connect path touches the heap afterwards
+  snprintf(baseTopic, sizeof(baseTopic),
+           "%s/%s/%s", mqttUser, site, deviceId);
+  snprintf(clientId, sizeof(clientId),
+           "%s_%s_%s", DEVICE_NAME, deviceId, chipIdHex);
 
   // Configure WiFi and MQTT clients
   WiFi.mode(WIFI_STA);
@@ -73,31 +161,107 @@ void WifiMqttClient::begin(
   // Increase MQTT buffer to support JSON payloads
   mqtt.setBufferSize(1024);
 
-  // Perform initial connections
-  connectWifi();
-  connectMqtt();
+  // Mount LittleFS for the offline publish queue; a leftover log from
+  // before the last reboot is drained once the connection is up
+  fsReady = LittleFS.begin();
+  if (fsReady) {
+    flashQueued = LittleFS.exists(QUEUE_FILE);
+  }
+
+  // Kick off the first connection attempt. Subscriptions registered in
+  // setup() land via the resubscribe registry once the session is up, so
+  // there is no need to block here waiting for the connection.
+  startWifi();
 }
 
 /**
  * @brief Main service loop.
  *
- * Ensures WiFi and MQTT connections remain active
- * and processes incoming MQTT messages.
+ * Advances the non-blocking connection state machine and
+ * processes incoming MQTT messages while connected.
  */
 void WifiMqttClient::loop() {
 
-  // Reconnect WiFi if connection was lost
-  if (WiFi.status() != WL_CONNECTED) {
-    connectWifi();
-  }
+  const uint32_t now = millis();
 
-  // Reconnect MQTT if disconnected
-  if (!mqtt.connected()) {
-    connectMqtt();
-  }
+  // Ship coalesced publishes whose hold deadline has passed; while the
+  // broker is down they land in the offline queue like any publish
+  flushCoalesced();
+
+  switch (connState) {
+
+    case ConnState::Idle:
+      // begin() has not been called yet; nothing to do
+      break;
+
+    case ConnState::ConnectingWifi:
+      if (WiFi.status() == WL_CONNECTED) {
+        Serial.print("WiFi connected, IP: ");
+        Serial.println(WiFi.localIP());
+
+        // WiFi up: join mDNS so a LAN broker can be discovered,
+        // then move on to the broker
+        MDNS.begin(clientId);
+
+        connState = ConnState::ConnectingMqtt;
+        nextMqttAttempt = now;
+        backoffMs = BACKOFF_MIN_MS;
+        failedAttempts = 0;
+      }
+      else if ((int32_t)(now - (wifiAttemptStart + WIFI_ATTEMPT_TIMEOUT_MS)) >= 0) {
+        // Association stalled: restart the attempt
+        Serial.println("WiFi connect timeout, retrying");
+        startWifi();
+      }
+      break;
+
+    case ConnState::ConnectingMqtt:
+      if (WiFi.status() != WL_CONNECTED) {
+        // WiFi dropped while waiting for the broker
+        startWifi();
+        break;
+      }
+
+      // Attempt at most one connect per backoff interval
+      if ((int32_t)(now - nextMqttAttempt) >= 0) {
+        tryMqtt();
+      }
+      break;
+
+    case ConnState::Connected:
+      if (WiFi.status() != WL_CONNECTED) {
+        startWifi();
+        break;
+      }
+
+      if (!mqtt.connected()) {
+        // Broker session lost: re-enter backoff-driven reconnect
+        Serial.println("MQTT connection lost");
+        connState = ConnState::ConnectingMqtt;
+        nextMqttAttempt = now;
+        backoffMs = BACKOFF_MIN_MS;
+        break;
+      }
+
+      // While on the fallback, periodically move back to the primary;
+      // the resubscribe registry and publish queue migrate the session
+      if (onFallback && (int32_t)(now - primaryRetryAt) >= 0) {
+        Serial.println("Retrying primary broker");
+        mqtt.disconnect();
+        selectBroker(false);
+        connState = ConnState::ConnectingMqtt;
+        nextMqttAttempt = now;
+        break;
+      }
+
+      // Deliver publishes queued during the outage
+      drainQueue();
 
-  // Process MQTT client state machine
-  mqtt.loop();
+      // Process MQTT client state machine
+      mqtt.loop();
+      MDNS.update();
+      break;
+  }
 }
 
 /**
@@ -110,78 +274,188 @@ bool WifiMqttClient::connected() {
 }
 
 /**
- * @brief Establishes a WiFi connection.
+ * @brief Drops the network for a low-power idle period.
+ */
+void WifiMqttClient::suspend() {
+  // Held publishes must not sleep through their deadline
+  flushCoalesced(true);
+
+  if (mqtt.connected()) {
+    mqtt.disconnect();
+  }
+
+  // Park the state machine so loop() does nothing while asleep
+  connState = ConnState::Idle;
+
+  WiFi.mode(WIFI_OFF);
+  WiFi.forceSleepBegin();
+  delay(1);  // Let the modem actually enter sleep
+
+  Serial.println("Network suspended (modem sleep)");
+}
+
+/**
+ * @brief Restarts the network after suspend().
+ */
+void WifiMqttClient::resume() {
+  WiFi.forceSleepWake();
+  delay(1);
+  WiFi.mode(WIFI_STA);
+
+  Serial.println("Network resuming");
+
+  // Re-enter the non-blocking connect state machine
+  startWifi();
+}
+
+/**
+ * @brief Starts a WiFi connection attempt.
  *
- * Blocks until connected or timeout occurs.
- * Safe to call repeatedly.
+ * Issues WiFi.begin() and records the attempt start time;
+ * association progress is monitored from loop().
  */
-void WifiMqttClient::connectWifi() {
+void WifiMqttClient::startWifi() {
 
-    Serial.println();
-    Serial.println("=== WiFi: connect start ===");
-    Serial.print("SSID: ");
-    Serial.println(wifiSsid);
+  Serial.println();
+  Serial.println("=== WiFi: connect start ===");
+  Serial.print("SSID: ");
+  Serial.println(wifiSsid);
 
-    // Abort if already connected
-    if (WiFi.status() == WL_CONNECTED) return;
+  // (Re)start WiFi connection attempt
+  WiFi.begin(wifiSsid, wifiPass);
 
-    Serial.print("WiFi mode: ");
-    Serial.println(WIFI_STA ? "STA" : "UNKNOWN");
+  wifiAttemptStart = millis();
+  connState = ConnState::ConnectingWifi;
+}
 
-    Serial.println("Calling WiFi.begin()");
+/**
+ * @brief Attempts a single MQTT connection.
+ *
+ * Uses the client ID composed once in begin(). On failure the backoff
+ * interval is doubled and the next attempt is scheduled; on success
+ * the state machine enters Connected.
+ */
+void WifiMqttClient::tryMqtt() {
 
-    // Start WiFi connection attempt
-    WiFi.begin(wifiSsid, wifiPass);
-    
-    unsigned long start = millis();
-    uint8_t dots = 0;
+  // Over TLS this call also runs the handshake. PubSubClient offers no
+  // incremental connect, so it cannot be split across loop() passes;
+  // the attached BearSSL session keeps it to one abbreviated round
+  // trip on every reconnect after the first.
 
-    // Wait until connected or timeout
-    while (WiFi.status() != WL_CONNECTED) {
-      Serial.print(".");
-      dots++;
+  // Attempt MQTT connection using credentials. clean_session=false keeps
+  // the broker-side session (QoS 1 subscriptions and missed messages)
+  // alive across disconnects under the stable chipId-derived client ID.
+  if (mqtt.connect(clientId, mqttUser, mqttPass,
+                   nullptr, 0, false, nullptr, false)) {
+    Serial.printf("MQTT connected (%s broker)\n",
+                  onFallback ? "fallback" : "primary");
+    connState = ConnState::Connected;
+    backoffMs = BACKOFF_MIN_MS;
+    failedAttempts = 0;
 
-      // Print newline every 16 dots for readability
-      if (dots % 16 == 0) {
-        Serial.println();
-      }
+    // Schedule the next primary probe while riding the fallback
+    if (onFallback) {
+      primaryRetryAt = millis() + PRIMARY_RETRY_MS;
+    }
 
-      // Abort after 15 seconds to avoid permanent blocking
-      if (millis() - start > 15000) {
-        Serial.println();
-        Serial.println("WiFi connect timeout (15s)");
-        return;
-      }
+    // Replay the subscription registry. The persistent session usually
+    // preserves subscriptions, but a broker restart (or a broker without
+    // session storage) silently discards them; replaying is cheap and
+    // idempotent, so it always runs.
+    resubscribeAll();
 
-      delay(500);
+    // Notify the sketch on a fully wired session
+    if (readyHandler != nullptr) {
+      readyHandler();
     }
+    return;
+  }
+
+  // Schedule next attempt with exponential backoff
+  Serial.printf("MQTT connect failed (rc=%d), retry in %lu ms\n",
+                mqtt.state(), (unsigned long)backoffMs);
+
+  nextMqttAttempt = millis() + backoffMs;
+  growBackoff();
+
+  // Repeated failures: switch to the other broker. With the minimum
+  // backoff this moves a node onto the LAN broker within a couple of
+  // seconds of the WAN link dropping.
+  failedAttempts++;
+  if (failedAttempts >= FAILOVER_ATTEMPTS) {
+    failedAttempts = 0;
+
+    if (!onFallback && resolveFallback()) {
+      selectBroker(true);
+      nextMqttAttempt = millis();
+      backoffMs = BACKOFF_MIN_MS;
+    } else if (onFallback) {
+      // Fallback died too: go back to trying the primary
+      selectBroker(false);
+      nextMqttAttempt = millis();
+      backoffMs = BACKOFF_MIN_MS;
+    }
+  }
 }
 
 /**
- * @brief Establishes an MQTT connection.
+ * @brief Resolves a fallback broker to switch to.
  *
- * Blocks until connected. Generates a unique
- * client ID based on device and chip identifiers.
+ * An explicitly registered fallback wins; otherwise mDNS is queried
+ * for a LAN broker advertising _mqtt._tcp (the site gateway) and the
+ * first answer is cached for subsequent failovers.
+ *
+ * @return true if a fallback broker is known, false otherwise.
  */
-void WifiMqttClient::connectMqtt() {
+bool WifiMqttClient::resolveFallback() {
+  if (fallbackHost != nullptr) return true;
+  if (discoveredHost[0] != '\0') return true;
 
-  // Retry until MQTT connection succeeds
-  while (!mqtt.connected()) {
+  const int found = MDNS.queryService("mqtt", "tcp");
+  if (found <= 0) {
+    Serial.println("No LAN broker found via mDNS");
+    return false;
+  }
 
-    // Construct unique MQTT client ID
-    String clientId =
-      String(DEVICE_NAME) + "_" +
-      deviceId +
-      "_" +
-      String((uint32_t)chipId, HEX);
+  const IPAddress ip = MDNS.IP(0);
+  snprintf(discoveredHost, sizeof(discoveredHost),
+           "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+  discoveredPort = MDNS.port(0);
 
-    // Attempt MQTT connection using credentials
-    mqtt.connect(clientId.c_str(), mqttUser, mqttPass);
+  Serial.printf("Discovered LAN broker %s:%u\n",
+                discoveredHost, discoveredPort);
+  return true;
+}
 
-    // Wait before retrying on failure
-    if (!mqtt.connected()) {
-      delay(2000);
+/**
+ * @brief Points the MQTT client at the primary or fallback broker.
+ *
+ * @param useFallback true for the fallback broker, false for primary.
+ */
+void WifiMqttClient::selectBroker(bool useFallback) {
+  if (useFallback) {
+    if (fallbackHost != nullptr) {
+      mqtt.setServer(fallbackHost, fallbackPort);
+      Serial.printf("Failing over to %s:%u\n", fallbackHost, fallbackPort);
+    } else {
+      mqtt.setServer(discoveredHost, discoveredPort);
+      Serial.printf("Failing over to %s:%u\n",
+                    discoveredHost, discoveredPort);
     }
+  } else {
+    mqtt.setServer(mqttHost, mqttPort);
+  }
+
+  onFallback = useFallback;
+}
+
+/**
+ * @brief Doubles the reconnect backoff up to its maximum.
+ */
+void WifiMqttClient::growBackoff() {
+  backoffMs *= 2;
+  if (backoffMs > BACKOFF_MAX_MS) {
+    backoffMs = BACKOFF_MAX_MS;
   }
 }
 
@@ -192,15 +466,187 @@ void WifiMqttClient::connectMqtt() {
  *   <user>/<site>/<deviceId>/<suffix>
  *
  * @param suffix Topic suffix.
- * @return Constructed topic as an Arduino String.
+ * @return Pointer to the scratch buffer holding the composed topic,
+ *         valid until the next makeTopic() call.
  */
-String WifiMqttClient::makeTopic(const char* suffix) const {
-  return baseTopic + "/" + suffix;
+const char* WifiMqttClient::makeTopic(const char* suffix) {
+  snprintf(topicScratch, sizeof(topicScratch), "%s/%s", baseTopic, suffix);
+  return topicScratch;
+}
+
+/**
+ * @brief Returns the current free heap in bytes.
+ *
+ * @return Free heap size in bytes.
+ */
+uint32_t WifiMqttClient::freeHeap() const {
+  return ESP.getFreeHeap();
+}
+
+/**
+ * @brief Returns the largest allocatable heap block in bytes.
+ *
+ * @return Largest contiguous free block in bytes.
+ */
+uint16_t WifiMqttClient::largestHeapBlock() const {
+  return ESP.getMaxFreeBlockSize();
 }
 
 /**
  * @brief Publishes a JSON document to an MQTT topic.
  *
+ * Topics with a registered coalescing policy are routed into their
+ * hold buffer and flushed from loop(); everything else is published
+ * immediately.
+ *
+ * @param topicSuffix Topic suffix appended to the base topic.
+ * @param data JSON document containing application payload.
+ * @return true if the message was published, held, or queued.
+ */
+bool WifiMqttClient::publishJson(
+  const char* topicSuffix,
+  const JsonDocument& data
+) {
+  for (uint8_t i = 0; i < coalesceCount; i++) {
+    if (strcmp(coalesceSlots[i].topicSuffix, topicSuffix) == 0) {
+      return coalesce(i, data);
+    }
+  }
+
+  return publishJsonNow(topicSuffix, data);
+}
+
+/**
+ * @brief Registers a coalescing policy for a topic suffix.
+ *
+ * @param topicSuffix Topic suffix the policy applies to.
+ * @param policy Coalescing policy.
+ * @param flushMs Maximum time (ms) a held publish waits for a flush.
+ * @return Slot ID, or -1 if the policy table is full.
+ */
+int8_t WifiMqttClient::coalesceTopic(
+  const char* topicSuffix,
+  PublishPolicy policy,
+  uint32_t flushMs
+) {
+  if (coalesceCount >= MAX_COALESCED) {
+    Serial.println("coalesceTopic: policy table full");
+    return -1;
+  }
+
+  CoalesceSlot& slot = coalesceSlots[coalesceCount];
+
+  strncpy(slot.topicSuffix, topicSuffix, sizeof(slot.topicSuffix) - 1);
+  slot.topicSuffix[sizeof(slot.topicSuffix) - 1] = '\0';
+  slot.policy   = policy;
+  slot.flushMs  = flushMs;
+  slot.deadline = 0;
+  slot.pending  = false;
+
+  return (int8_t)coalesceCount++;
+}
+
+/**
+ * @brief Routes a topic suffix to the low-priority telemetry lane.
+ *
+ * @param topicSuffix Topic suffix to route to the telemetry lane.
+ * @return true if registered, false if the lane table is full.
+ */
+bool WifiMqttClient::telemetryTopic(const char* topicSuffix) {
+  if (telemetryCount >= MAX_TELEMETRY) {
+    Serial.println("telemetryTopic: lane table full");
+    return false;
+  }
+
+  strncpy(telemetryTopics[telemetryCount], topicSuffix,
+          sizeof(telemetryTopics[0]) - 1);
+  telemetryTopics[telemetryCount][sizeof(telemetryTopics[0]) - 1] = '\0';
+  telemetryCount++;
+  return true;
+}
+
+/**
+ * @brief Checks whether a topic suffix rides the telemetry lane.
+ *
+ * @param topicSuffix Topic suffix of a publish.
+ * @return true if the suffix is registered as telemetry.
+ */
+bool WifiMqttClient::isTelemetry(const char* topicSuffix) const {
+  for (uint8_t i = 0; i < telemetryCount; i++) {
+    if (strcmp(telemetryTopics[i], topicSuffix) == 0) return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Collapses a publish into its topic's coalescing buffer.
+ *
+ * LatestWins replaces the held data outright; Append accumulates data
+ * objects into an array, flushing early if the buffer fills up. The
+ * flush deadline is armed by the first held publish of a burst.
+ *
+ * @param slot Coalescing slot of the topic.
+ * @param data JSON document of the publish.
+ * @return true if the publish was held or sent, false otherwise.
+ */
+bool WifiMqttClient::coalesce(uint8_t slot, const JsonDocument& data) {
+  CoalesceSlot& entry = coalesceSlots[slot];
+  StaticJsonDocument<COALESCE_DOC_SIZE>& held = coalesceDocs[slot];
+
+  if (entry.policy == PublishPolicy::LatestWins) {
+    // Newest state wins; an oversized document bypasses the buffer
+    if (!held.set(data)) {
+      held.clear();
+      return publishJsonNow(entry.topicSuffix, data);
+    }
+  } else {
+    JsonArray batch = entry.pending
+      ? held.as<JsonArray>()
+      : held.to<JsonArray>();
+
+    // Buffer full: ship the batch now and start a new one
+    if (!batch.add(data)) {
+      publishJsonNow(entry.topicSuffix, held);
+      batch = held.to<JsonArray>();
+      entry.pending = false;
+
+      if (!batch.add(data)) {
+        return publishJsonNow(entry.topicSuffix, data);
+      }
+    }
+  }
+
+  if (!entry.pending) {
+    entry.pending  = true;
+    entry.deadline = millis() + entry.flushMs;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Publishes coalescing buffers whose deadline has passed.
+ *
+ * @param force Flush all held publishes regardless of deadline.
+ */
+void WifiMqttClient::flushCoalesced(bool force) {
+  const uint32_t now = millis();
+
+  for (uint8_t i = 0; i < coalesceCount; i++) {
+    CoalesceSlot& entry = coalesceSlots[i];
+
+    if (!entry.pending) continue;
+    if (!force && (int32_t)(now - entry.deadline) < 0) continue;
+
+    publishJsonNow(entry.topicSuffix, coalesceDocs[i]);
+    coalesceDocs[i].clear();
+    entry.pending = false;
+  }
+}
+
+/**
+ * @brief Publishes a JSON document immediately (pre-coalescing path).
+ *
  * Wraps the provided JSON data in a standard envelope
  * containing device metadata and a timestamp.
  *
@@ -208,7 +654,7 @@ String WifiMqttClient::makeTopic(const char* suffix) const {
  * @param data JSON document containing application payload.
  * @return true if publish succeeded, false otherwise.
  */
-bool WifiMqttClient::publishJson(
+bool WifiMqttClient::publishJsonNow(
   const char* topicSuffix,
   const JsonDocument& data
 ) {
@@ -218,9 +664,11 @@ bool WifiMqttClient::publishJson(
   JsonObject device = envelope.createNestedObject("device");
   device["id"]       = deviceId;
   device["platform"] = DEVICE_NAME;
-  device["chip_id"]  = String((uint32_t)chipId, HEX);
+  device["chip_id"]  = chipIdHex;
 
-  // Attach timestamp and payload
+  // Attach correlation ID, timestamp, and payload. The backend echoes
+  // "seq" in its responses so senders can match them exactly.
+  envelope["seq"]        = ++publishSeq;
   envelope["sent_ts_ms"] = millis();
   envelope["data"]       = data;
 
@@ -228,12 +676,315 @@ bool WifiMqttClient::publishJson(
   char buffer[512];
   size_t len = serializeJson(envelope, buffer);
 
+  // Broker unreachable: queue for delivery after reconnect
+  if (!mqtt.connected()) {
+    return enqueuePublish(topicSuffix, buffer, len);
+  }
+
+  // Telemetry lane: hand the frame to the queue instead of the socket,
+  // so an access-path publish issued now is still next on the wire
+  if (isTelemetry(topicSuffix)) {
+    return enqueuePublish(topicSuffix, buffer, len);
+  }
+
   // Publish serialized payload
-  return mqtt.publish(
-    makeTopic(topicSuffix).c_str(),
+  bool ok = mqtt.publish(
+    makeTopic(topicSuffix),
     buffer,
     len
   );
+
+  // A failed publish usually means the connection just dropped;
+  // queue the message rather than lose it
+  if (!ok) {
+    return enqueuePublish(topicSuffix, buffer, len);
+  }
+
+  return true;
+}
+
+/**
+ * @brief Publishes a packed binary frame to an MQTT topic.
+ *
+ * The frame bytes go on the wire unmodified; the fixed header already
+ * carries device identity and timestamp, so no envelope is added.
+ *
+ * @param topicSuffix Topic suffix appended to the base topic.
+ * @param frame Composed packed frame.
+ * @return true if the frame was published or queued, false otherwise.
+ */
+bool WifiMqttClient::publishPacked(
+  const char* topicSuffix,
+  const PackedWriter& frame
+) {
+  // Broker unreachable: queue the raw frame like a JSON publish
+  if (!mqtt.connected()) {
+    return enqueuePublish(
+      topicSuffix,
+      reinterpret_cast<const char*>(frame.data()),
+      frame.size()
+    );
+  }
+
+  bool ok = mqtt.publish(
+    makeTopic(topicSuffix),
+    frame.data(),
+    frame.size()
+  );
+
+  if (!ok) {
+    return enqueuePublish(
+      topicSuffix,
+      reinterpret_cast<const char*>(frame.data()),
+      frame.size()
+    );
+  }
+
+  return true;
+}
+
+/**
+ * @brief Returns the chip identifier used in client IDs and packed frames.
+ *
+ * @return 32-bit chip ID.
+ */
+uint32_t WifiMqttClient::deviceChipId() const {
+  return (uint32_t)chipId;
+}
+
+/**
+ * @brief Returns the sequence number stamped on the last publishJson().
+ *
+ * @return Sequence number of the most recent publish.
+ */
+uint32_t WifiMqttClient::lastSeq() const {
+  return publishSeq;
+}
+
+/**
+ * @brief Queues a serialized publish for delivery after reconnect.
+ *
+ * If an older entry for the same topic suffix is already queued, it is
+ * overwritten in place (newest wins) so superseded events do not pile
+ * up. Otherwise, when the RAM ring is full, its oldest entry is spilled
+ * to the flash-backed log to make room.
+ *
+ * @param topicSuffix Topic suffix of the publish.
+ * @param payload Serialized JSON payload.
+ * @param length Payload length in bytes.
+ * @return true if the message was queued, false otherwise.
+ */
+bool WifiMqttClient::enqueuePublish(
+  const char* topicSuffix,
+  const char* payload,
+  size_t length
+) {
+  if (length >= QUEUE_PAYLOAD_MAX) {
+    Serial.println("enqueuePublish: payload too large");
+    return false;
+  }
+
+  // Newest-wins coalescing: replace an already-queued message
+  // for the same topic suffix instead of queueing a duplicate
+  for (uint8_t i = 0; i < queueCount; i++) {
+    QueuedPublish& entry = queue[(queueHead + i) % QUEUE_CAPACITY];
+
+    if (strcmp(entry.topicSuffix, topicSuffix) == 0) {
+      memcpy(entry.payload, payload, length);
+      entry.length = (uint16_t)length;
+      return true;
+    }
+  }
+
+  // Ring full: spill the oldest entry to flash to make room
+  if (queueCount == QUEUE_CAPACITY) {
+    if (!spillToFlash(queue[queueHead])) {
+      // Flash unavailable: drop the oldest entry outright
+      Serial.println("enqueuePublish: dropping oldest queued publish");
+    }
+    queueHead = (queueHead + 1) % QUEUE_CAPACITY;
+    queueCount--;
+  }
+
+  // Append the new message at the tail of the ring
+  QueuedPublish& slot = queue[(queueHead + queueCount) % QUEUE_CAPACITY];
+
+  strncpy(slot.topicSuffix, topicSuffix, sizeof(slot.topicSuffix) - 1);
+  slot.topicSuffix[sizeof(slot.topicSuffix) - 1] = '\0';
+
+  memcpy(slot.payload, payload, length);
+  slot.length = (uint16_t)length;
+
+  queueCount++;
+  return true;
+}
+
+/**
+ * @brief Appends a queued publish to the LittleFS-backed log.
+ *
+ * Records are length-prefixed: suffix length, payload length, then the
+ * raw bytes. When the log exceeds its size cap it is discarded and
+ * restarted, bounding both flash wear and drain time.
+ *
+ * @param entry Queue entry to spill.
+ * @return true if the record was written, false otherwise.
+ */
+bool WifiMqttClient::spillToFlash(const QueuedPublish& entry) {
+  if (!fsReady) return false;
+
+  // Bound the log: discard the backlog when the cap is exceeded
+  File check = LittleFS.open(QUEUE_FILE, "r");
+  if (check && check.size() > QUEUE_FILE_MAX) {
+    check.close();
+    LittleFS.remove(QUEUE_FILE);
+    flashReadOffset = 0;  // The drain position died with the old log
+    Serial.println("spillToFlash: queue log full, discarding backlog");
+  } else if (check) {
+    check.close();
+  }
+
+  File f = LittleFS.open(QUEUE_FILE, "a");
+  if (!f) return false;
+
+  uint8_t suffixLen = (uint8_t)strlen(entry.topicSuffix);
+  uint16_t payloadLen = entry.length;
+
+  f.write(&suffixLen, 1);
+  f.write(reinterpret_cast<const uint8_t*>(&payloadLen), 2);
+  f.write(reinterpret_cast<const uint8_t*>(entry.topicSuffix), suffixLen);
+  f.write(reinterpret_cast<const uint8_t*>(entry.payload), payloadLen);
+  f.close();
+
+  flashQueued = true;
+  return true;
+}
+
+/**
+ * @brief Publishes queued messages in batches while connected.
+ *
+ * Flash-spilled messages are the oldest, so the flash log is drained
+ * before the RAM ring. At most QUEUE_DRAIN_BATCH messages are sent per
+ * call to keep loop() latency bounded.
+ */
+void WifiMqttClient::drainQueue() {
+
+  uint8_t sent = 0;
+
+  // Flash and RAM drains share the batch budget
+  if (flashQueued) {
+    sent = drainFlash(QUEUE_DRAIN_BATCH);
+  }
+
+  while (queueCount > 0 && sent < QUEUE_DRAIN_BATCH) {
+    QueuedPublish& entry = queue[queueHead];
+
+    bool ok = mqtt.publish(
+      makeTopic(entry.topicSuffix),
+      reinterpret_cast<const uint8_t*>(entry.payload),
+      entry.length
+    );
+
+    // Connection dropped again: keep the message queued
+    if (!ok) return;
+
+    queueHead = (queueHead + 1) % QUEUE_CAPACITY;
+    queueCount--;
+    sent++;
+  }
+}
+
+/**
+ * @brief Publishes a bounded batch of records from the flash log.
+ *
+ * The log is read sequentially (oldest first) from a read offset that
+ * advances past each published record and persists across calls, so a
+ * long log drains over several loop() passes instead of blocking one.
+ * On a mid-drain disconnect the drain resumes at the offset on the
+ * next reconnect; at most the record in flight when the connection
+ * dropped is delivered twice, and none are lost. The file is removed
+ * once the last record is out.
+ *
+ * @param budget Maximum number of records to publish this call.
+ * @return Number of records published.
+ */
+uint8_t WifiMqttClient::drainFlash(uint8_t budget) {
+  if (!fsReady) {
+    flashQueued = false;
+    return 0;
+  }
+
+  File f = LittleFS.open(QUEUE_FILE, "r");
+  if (!f) {
+    flashQueued = false;
+    flashReadOffset = 0;
+    return 0;
+  }
+
+  f.seek(flashReadOffset);
+
+  QueuedPublish entry;
+  uint8_t sent = 0;
+  bool corrupt = false;
+
+  while (f.available() && sent < budget) {
+    uint8_t suffixLen = 0;
+    uint16_t payloadLen = 0;
+
+    // Read the record header; a truncated log is dropped, not retried
+    if (f.read(&suffixLen, 1) != 1 ||
+        f.read(reinterpret_cast<uint8_t*>(&payloadLen), 2) != 2 ||
+        suffixLen >= sizeof(entry.topicSuffix) ||
+        payloadLen >= QUEUE_PAYLOAD_MAX) {
+      corrupt = true;
+      break;
+    }
+
+    if (f.read(reinterpret_cast<uint8_t*>(entry.topicSuffix), suffixLen)
+          != suffixLen ||
+        f.read(reinterpret_cast<uint8_t*>(entry.payload), payloadLen)
+          != payloadLen) {
+      corrupt = true;
+      break;
+    }
+
+    entry.topicSuffix[suffixLen] = '\0';
+    entry.length = payloadLen;
+
+    bool ok = mqtt.publish(
+      makeTopic(entry.topicSuffix),
+      reinterpret_cast<const uint8_t*>(entry.payload),
+      entry.length
+    );
+
+    // Connection dropped mid-drain: resume from the offset next time
+    if (!ok) {
+      f.close();
+      return sent;
+    }
+
+    flashReadOffset = f.position();
+    sent++;
+  }
+
+  bool drained = corrupt || !f.available();
+  f.close();
+
+  if (drained) {
+    LittleFS.remove(QUEUE_FILE);
+    flashQueued = false;
+    flashReadOffset = 0;
+  }
+
+  return sent;
+}
+
+/**
+ * @brief Returns the number of publishes waiting in the RAM queue.
+ *
+ * @return Queued publish count.
+ */
+uint8_t WifiMqttClient::queuedCount() const {
+  return queueCount;
 }
 
 /**
@@ -246,14 +997,31 @@ void WifiMqttClient::setCallback(MQTT_CALLBACK_SIGNATURE) {
 }
 
 /**
- * @brief Subscribes to an MQTT topic.
+ * @brief Subscribes to an MQTT topic at QoS 1.
  *
  * @param topic Full MQTT topic string.
  * @return true if subscription succeeded, false otherwise.
  */
 bool WifiMqttClient::subscribe(const char* topic) {
   if (!mqtt.connected()) return false;
-  return mqtt.subscribe(topic);
+  return mqtt.subscribe(topic, 1);
+}
+
+/**
+ * @brief Checks whether a message key was seen recently (and records it).
+ *
+ * @param key Message key, typically the envelope's "seq" field.
+ * @return true if the key was already seen, false if it is new.
+ */
+bool WifiMqttClient::seenRecently(uint32_t key) {
+  for (uint8_t i = 0; i < SEEN_WINDOW; i++) {
+    if (seenKeys[i] == key) return true;
+  }
+
+  // New key: record it, overwriting the oldest slot
+  seenKeys[seenIndex] = key;
+  seenIndex = (seenIndex + 1) % SEEN_WINDOW;
+  return false;
 }
 
 /**
@@ -266,3 +1034,183 @@ bool WifiMqttClient::unsubscribe(const char* topic) {
   if (!mqtt.connected()) return false;
   return mqtt.unsubscribe(topic);
 }
+
+/**
+ * @brief Registers a topic suffix in the topic table and subscribes.
+ *
+ * Composes the fully qualified topic once into a fixed table entry;
+ * subsequent received messages are matched against the table without
+ * any heap allocation.
+ *
+ * Registration never depends on connection state: if the broker is
+ * unreachable (typical during setup()) the subscription is issued by
+ * resubscribeAll() as soon as the session comes up.
+ *
+ * @param suffix Topic suffix (e.g. "access/response").
+ * @return Topic ID for matchTopic(), or -1 on failure.
+ */
+int8_t WifiMqttClient::subscribeTopic(const char* suffix) {
+
+  if (topicCount >= MAX_TOPICS) {
+    Serial.println("subscribeTopic: topic table full");
+    return -1;
+  }
+
+  // Compose <base>/<suffix> into the table slot
+  int written = snprintf(
+    topicTable[topicCount], TOPIC_MAX_LEN,
+    "%s/%s", baseTopic, suffix
+  );
+
+  if (written < 0 || (size_t)written >= TOPIC_MAX_LEN) {
+    Serial.println("subscribeTopic: topic too long");
+    return -1;
+  }
+
+  // Subscribe now if possible; otherwise the connect path replays the
+  // registry, so a registration made while offline still takes effect
+  if (mqtt.connected()) {
+    subscribe(topicTable[topicCount]);
+  }
+
+  return (int8_t)topicCount++;
+}
+
+/**
+ * @brief Replays every registered topic to the broker in one burst.
+ *
+ * All SUBSCRIBE packets are written back to back and flushed together,
+ * so the node is fully wired after a single round trip regardless of
+ * how many topics are registered.
+ */
+void WifiMqttClient::resubscribeAll() {
+  for (uint8_t i = 0; i < topicCount; i++) {
+    if (!mqtt.subscribe(topicTable[i], 1)) {
+      Serial.printf("resubscribeAll: subscribe failed for %s\n",
+                    topicTable[i]);
+    }
+  }
+
+  if (topicCount > 0) {
+    Serial.printf("Resubscribed %u topic(s)\n", (unsigned)topicCount);
+  }
+}
+
+/**
+ * @brief Sets the handler fired after each successful (re)connect.
+ *
+ * @param handler Ready handler, or nullptr to clear.
+ */
+void WifiMqttClient::onReady(ReadyHandler handler) {
+  readyHandler = handler;
+}
+
+/**
+ * @brief Matches a received topic against the registered topic table.
+ *
+ * @param topic Full topic of the received message.
+ * @return Registered topic ID, or -1 if unknown.
+ */
+int8_t WifiMqttClient::matchTopic(const char* topic) const {
+  for (uint8_t i = 0; i < topicCount; i++) {
+    if (strcmp(topic, topicTable[i]) == 0) {
+      return (int8_t)i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief Returns the fully qualified topic for a registered topic ID.
+ *
+ * @param id Topic ID returned by subscribeTopic().
+ * @return Topic string, or nullptr for an invalid ID.
+ */
+const char* WifiMqttClient::topicAt(int8_t id) const {
+  if (id < 0 || id >= (int8_t)topicCount) return nullptr;
+  return topicTable[id];
+}
+
+/**
+ * @brief Declares which JSON fields a topic's handler actually reads.
+ *
+ * The dotted paths are expanded once into a filter document; building
+ * it here keeps the per-message cost of parseJson() at a table lookup.
+ *
+ * @param id Topic ID returned by subscribeTopic().
+ * @param paths Space-separated dotted field paths.
+ * @return true if the filter was built, false otherwise.
+ */
+bool WifiMqttClient::filterTopic(int8_t id, const char* paths) {
+
+  if (id < 0 || id >= (int8_t)topicCount) return false;
+
+  if (filterCount >= MAX_FILTERS) {
+    Serial.println("filterTopic: filter table full");
+    return false;
+  }
+
+  // Work on a local copy; the tokenizer writes terminators into it
+  char buf[96];
+  strlcpy(buf, paths, sizeof(buf));
+
+  JsonObject root = filterDocs[filterCount].to<JsonObject>();
+
+  // One dotted path per whitespace-separated token
+  for (char* path = strtok(buf, " "); path != nullptr;
+       path = strtok(nullptr, " ")) {
+
+    JsonObject node = root;
+    char* seg = path;
+
+    // Descend through intermediate segments, creating objects as needed
+    for (char* dot = strchr(seg, '.'); dot != nullptr;
+         dot = strchr(seg, '.')) {
+      *dot = '\0';
+      JsonObject child = node[seg];
+      if (child.isNull()) child = node.createNestedObject(seg);
+      node = child;
+      seg = dot + 1;
+    }
+
+    // Leaf: mark this field for materialization
+    node[seg] = true;
+  }
+
+  filterSlot[id] = (int8_t)filterCount++;
+  return true;
+}
+
+/**
+ * @brief Parses a received payload through the topic's filter.
+ *
+ * The payload buffer is parsed in situ (zero-copy): string values in
+ * the document point into the buffer instead of being duplicated, so
+ * they expire with the callback.
+ *
+ * @param id Topic ID of the received message.
+ * @param payload Raw payload bytes (modified by the parse).
+ * @param length Payload length.
+ * @param doc Document receiving the (filtered) parse result.
+ * @return Deserialization result; evaluates true on failure.
+ */
+DeserializationError WifiMqttClient::parseJson(
+  int8_t id,
+  byte* payload,
+  unsigned int length,
+  JsonDocument& doc
+) {
+  // Writable input selects ArduinoJson's in-situ zero-copy mode
+  char* input = reinterpret_cast<char*>(payload);
+
+  const int8_t slot =
+    (id >= 0 && id < (int8_t)topicCount) ? filterSlot[id] : (int8_t)-1;
+
+  if (slot >= 0) {
+    return deserializeJson(doc, input, length,
+                           DeserializationOption::Filter(filterDocs[slot]));
+  }
+
+  // No filter registered: parse the message in full
+  return deserializeJson(doc, input, length);
+}
@@ -23,6 +23,9 @@
 #include <PubSubClient.h>
 #include <ArduinoJson.h>
 #include <WiFiClient.h>
+#include <WiFiClientSecure.h>
+
+#include "PackedMessage.h"
 
 /**
  * @class WifiMqttClient
@@ -38,6 +41,59 @@
  */
 class WifiMqttClient {
 public:
+  /** @brief Maximum number of entries in the precomputed topic table. */
+  static constexpr uint8_t MAX_TOPICS = 12;
+
+  /** @brief Maximum length of a fully qualified topic (incl. terminator). */
+  static constexpr size_t TOPIC_MAX_LEN = 96;
+
+  /** @brief Maximum length of the composed base topic (incl. terminator). */
+  static constexpr size_t BASE_TOPIC_MAX = 64;
+
+  /** @brief Maximum length of the composed client ID (incl. terminator). */
+  static constexpr size_t CLIENT_ID_MAX = 48;
+
+  /** @brief Number of entries in the RAM tier of the offline publish queue. */
+  static constexpr uint8_t QUEUE_CAPACITY = 8;
+
+  /** @brief Maximum serialized payload size (bytes) of a queued publish. */
+  static constexpr size_t QUEUE_PAYLOAD_MAX = 384;
+
+  /**
+   * @brief Maximum queued publishes drained per loop() call.
+   *
+   * Kept small: this is the most wire time the telemetry lane can put
+   * in front of an access-path publish issued in the same pass.
+   */
+  static constexpr uint8_t QUEUE_DRAIN_BATCH = 2;
+
+  /** @brief Maximum number of topics routed to the telemetry lane. */
+  static constexpr uint8_t MAX_TELEMETRY = 6;
+
+  /**
+   * @brief Coalescing policy for a published topic.
+   */
+  enum class PublishPolicy : uint8_t {
+    LatestWins, /**< Newer data replaces unsent data; one frame per burst */
+    Append      /**< Data objects accumulate into one batched array frame */
+  };
+
+  /** @brief Maximum number of topics with a coalescing policy. */
+  static constexpr uint8_t MAX_COALESCED = 3;
+
+  /** @brief Capacity (bytes) of each coalescing buffer document. */
+  static constexpr size_t COALESCE_DOC_SIZE = 384;
+
+  /**
+   * @brief Callback fired after every (re)connect, once subscriptions
+   *        have been replayed.
+   *
+   * Runs each time the MQTT session is established, not just the first
+   * time, so it must be idempotent (e.g. publishing a presence message
+   * or retained state snapshot).
+   */
+  typedef void (*ReadyHandler)();
+
   /**
    * @brief Default constructor.
    *
@@ -72,14 +128,54 @@ public:
     const char* site
   );
 
+  /**
+   * @brief Switches the MQTT transport to TLS (BearSSL).
+   *
+   * Call before begin(), together with the broker's TLS port. The
+   * server is authenticated by certificate fingerprint (no clock or
+   * CA store needed on the node), and a BearSSL session is attached
+   * so every reconnect after the first resumes with an abbreviated
+   * handshake — roughly 300 ms instead of the 3-5 s full handshake
+   * that would otherwise burn the recovery budget.
+   *
+   * The session lives in RAM: the ESP8266 core has no API to
+   * serialize a BearSSL session, so the first connect after a cold
+   * boot pays one full handshake and everything after that resumes.
+   *
+   * @param fingerprintHex SHA-1 fingerprint of the broker certificate,
+   *        as a hex string ("AA:BB:..." or "aabb...").
+   */
+  void enableTls(const char* fingerprintHex);
+
+  /**
+   * @brief Registers an explicit fallback broker for LAN failover.
+   *
+   * The client connects to the primary broker from begin() and moves
+   * to the fallback after repeated connect failures; while on the
+   * fallback it periodically retries the primary. Without an explicit
+   * fallback, a LAN broker advertised via mDNS (_mqtt._tcp) is
+   * discovered and used instead.
+   *
+   * Thanks to the resubscribe registry and the offline publish queue,
+   * a broker switch migrates the whole session: subscriptions are
+   * replayed and queued publishes drained on the new broker.
+   *
+   * @param host Fallback broker hostname or IP.
+   * @param port Fallback broker port.
+   */
+  void setFallbackBroker(const char* host, uint16_t port);
+
   /**
    * @brief Main service loop.
    *
    * Must be called frequently from the Arduino loop().
-   * Handles:
-   * - WiFi reconnection
-   * - MQTT reconnection
-   * - MQTT client loop processing
+   * Runs the non-blocking connection state machine:
+   * - Starts and monitors WiFi association
+   * - Attempts MQTT connection with exponential backoff
+   * - Processes MQTT traffic while connected
+   *
+   * Never blocks; a broker or access point outage costs each
+   * call microseconds, not seconds.
    */
   void loop();
 
@@ -90,21 +186,147 @@ public:
    */
   bool connected();
 
+  /**
+   * @brief Drops the network for a low-power idle period.
+   *
+   * Disconnects MQTT, shuts the modem down (forced sleep), and parks
+   * the connection state machine so loop() becomes a no-op until
+   * resume() is called.
+   */
+  void suspend();
+
+  /**
+   * @brief Restarts the network after suspend().
+   *
+   * Wakes the modem and re-enters the non-blocking connect state
+   * machine; returns immediately while the connection is brought up
+   * in the background.
+   */
+  void resume();
+
   /**
    * @brief Publishes a JSON document to an MQTT topic.
    *
    * Automatically prefixes the topic with the base topic
    * (<user>/<site>/<deviceId>/).
    *
+   * While the broker is unreachable the serialized message is queued
+   * (RAM ring, spilling to a LittleFS-backed log) and drained in
+   * batches once the connection recovers, so events produced during
+   * an outage are delivered instead of dropped.
+   *
    * @param topicSuffix Topic suffix appended to the base topic.
    * @param data JSON document to serialize and publish.
-   * @return true if publish succeeded, false otherwise.
+   * @return true if the message was published or queued, false otherwise.
    */
   bool publishJson(
     const char* topicSuffix,
     const JsonDocument& data
   );
 
+  /**
+   * @brief Registers a coalescing policy for a topic suffix.
+   *
+   * Subsequent publishJson() calls to the topic are held for up to
+   * flushMs and collapsed according to the policy, so a burst (e.g.
+   * one tap event per keypress from a fast typist) leaves the node as
+   * a single frame instead of one per event:
+   * - LatestWins: newer data replaces unsent data; the frame carries
+   *   the most recent state when the deadline fires.
+   * - Append: each data object is appended to a JSON array published
+   *   as one batched frame (consumers must expect the array form).
+   *
+   * The deadline is armed by the first held publish, so an isolated
+   * event is delayed by at most flushMs.
+   *
+   * @param topicSuffix Topic suffix the policy applies to.
+   * @param policy Coalescing policy.
+   * @param flushMs Maximum time (ms) a held publish waits for a flush.
+   * @return Slot ID, or -1 if the policy table is full.
+   */
+  int8_t coalesceTopic(
+    const char* topicSuffix,
+    PublishPolicy policy,
+    uint32_t flushMs
+  );
+
+  /**
+   * @brief Routes a topic suffix to the low-priority telemetry lane.
+   *
+   * Publishes to a telemetry topic are never written to the socket at
+   * the call site: they are placed in the publish queue and drained
+   * from loop() a couple of frames per pass. Access-path publishes
+   * (the default lane) keep writing immediately, so they are always
+   * next on the wire — a 1 KB metrics report can no longer sit in
+   * front of an access request and add its serialization and TCP time
+   * to a person waiting at the door.
+   *
+   * Note the queue coalesces by suffix (newest wins), which is the
+   * right behavior for periodic state reports; do not route
+   * must-not-drop event streams through this lane.
+   *
+   * @param topicSuffix Topic suffix to route to the telemetry lane.
+   * @return true if registered, false if the lane table is full.
+   */
+  bool telemetryTopic(const char* topicSuffix);
+
+  /**
+   * @brief Publishes a packed binary frame to an MQTT topic.
+   *
+   * Parallel API to publishJson() for latency-critical topics: no JSON
+   * envelope is added, the frame goes on the wire as composed. Like
+   * publishJson(), the frame is queued for later delivery when the
+   * broker is unreachable.
+   *
+   * @param topicSuffix Topic suffix appended to the base topic.
+   * @param frame Composed packed frame.
+   * @return true if the frame was published or queued, false otherwise.
+   */
+  bool publishPacked(
+    const char* topicSuffix,
+    const PackedWriter& frame
+  );
+
+  /**
+   * @brief Returns the chip identifier used in client IDs and packed frames.
+   *
+   * @return 32-bit chip ID.
+   */
+  uint32_t deviceChipId() const;
+
+  /**
+   * @brief Checks whether a message key was seen recently (and records it).
+   *
+   * QoS 1 redelivery can duplicate messages after a reconnect; handlers
+   * with non-idempotent side effects (e.g. unlocking the door) pass the
+   * sender's "seq" here and skip the message when it returns true. Keys
+   * are kept in a small fixed window of the most recent values.
+   *
+   * @param key Message key, typically the envelope's "seq" field.
+   * @return true if the key was already seen, false if it is new.
+   */
+  bool seenRecently(uint32_t key);
+
+  /**
+   * @brief Returns the sequence number stamped on the last publishJson().
+   *
+   * Every JSON envelope carries a monotonically increasing "seq" field;
+   * a backend that echoes it in its response lets the sender correlate
+   * request and response exactly instead of guessing from timestamps.
+   *
+   * @return Sequence number of the most recent publish.
+   */
+  uint32_t lastSeq() const;
+
+  /**
+   * @brief Returns the number of publishes waiting in the RAM queue.
+   *
+   * Messages spilled to flash are not included.
+   *
+   * @return Queued publish count.
+   */
+  uint8_t queuedCount() const;
+
   /**
    * @brief Sets the MQTT message callback.
    *
@@ -115,7 +337,11 @@ public:
   void setCallback(MQTT_CALLBACK_SIGNATURE);
 
   /**
-   * @brief Subscribes to a topic.
+   * @brief Subscribes to a topic at QoS 1.
+   *
+   * Combined with the persistent session (clean_session=false), the
+   * broker stores messages that arrive while the node is offline and
+   * redelivers them on reconnect.
    *
    * The provided topic should already be fully constructed
    * (use makeTopic() if needed).
@@ -133,31 +359,265 @@ public:
    */
   bool unsubscribe(const char* topic);
 
+  /**
+   * @brief Registers a topic suffix in the topic table and subscribes.
+   *
+   * The fully qualified topic is composed once into a fixed table entry,
+   * so the receive path can match it without any heap allocation.
+   *
+   * The table doubles as the resubscribe registry: every entry is
+   * replayed to the broker each time the MQTT session is established,
+   * so registration succeeds even while disconnected and survives
+   * broker restarts that discard the server-side session.
+   *
+   * @param suffix Topic suffix (e.g. "access/response").
+   * @return Topic ID for use with matchTopic(), or -1 on failure
+   *         (table full or topic too long).
+   */
+  int8_t subscribeTopic(const char* suffix);
+
+  /**
+   * @brief Sets the handler fired after each successful (re)connect.
+   *
+   * The handler runs after all registered topics have been resubscribed,
+   * so anything it publishes is answered on a fully wired session.
+   *
+   * @param handler Ready handler, or nullptr to clear.
+   */
+  void onReady(ReadyHandler handler);
+
+  /**
+   * @brief Matches a received topic against the registered topic table.
+   *
+   * Allocation-free; intended for use inside the MQTT message callback.
+   *
+   * @param topic Full topic of the received message.
+   * @return Topic ID previously returned by subscribeTopic(),
+   *         or -1 if the topic is not registered.
+   */
+  int8_t matchTopic(const char* topic) const;
+
+  /**
+   * @brief Returns the fully qualified topic for a registered topic ID.
+   *
+   * @param id Topic ID returned by subscribeTopic().
+   * @return Topic string, or nullptr for an invalid ID.
+   */
+  const char* topicAt(int8_t id) const;
+
+  /**
+   * @brief Declares which JSON fields a topic's handler actually reads.
+   *
+   * Builds an ArduinoJson deserialization filter once so that
+   * parseJson() only materializes the declared fields; everything else
+   * in the message is skipped during parsing. Handlers typically read
+   * one or two fields out of a much larger envelope, so this cuts both
+   * parse time and document usage on the receive path.
+   *
+   * @param id Topic ID returned by subscribeTopic().
+   * @param paths Space-separated dotted field paths,
+   *        e.g. "seq response.hasAccess".
+   * @return true if the filter was built, false otherwise
+   *         (invalid ID or filter table full).
+   */
+  bool filterTopic(int8_t id, const char* paths);
+
+  /**
+   * @brief Parses a received payload through the topic's filter.
+   *
+   * Parsing is done in situ: the payload buffer is modified and strings
+   * in the document point into it, so they are only valid for the
+   * duration of the MQTT callback — copy anything that is kept. Topics
+   * without a registered filter are parsed in full.
+   *
+   * @param id Topic ID of the received message (from matchTopic()).
+   * @param payload Raw payload bytes (modified by the parse).
+   * @param length Payload length.
+   * @param doc Document receiving the (filtered) parse result.
+   * @return Deserialization result; evaluates true on failure.
+   */
+  DeserializationError parseJson(int8_t id, byte* payload,
+                                 unsigned int length, JsonDocument& doc);
+
   /**
    * @brief Constructs a fully qualified MQTT topic.
    *
    * Combines the base topic with a suffix:
    *   <user>/<site>/<deviceId>/<suffix>
    *
+   * Composed into a static scratch buffer — no heap allocation. The
+   * returned pointer is valid until the next makeTopic() call.
+   *
    * @param suffix Topic suffix (e.g. "access/request").
-   * @return Constructed topic as an Arduino String.
+   * @return Constructed topic string.
    */
-  String makeTopic(const char* suffix) const;
+  const char* makeTopic(const char* suffix);
+
+  /**
+   * @brief Returns the current free heap in bytes.
+   *
+   * Together with largestHeapBlock() this gauges heap fragmentation;
+   * with the library's static buffers the steady-state values should
+   * not drift over time.
+   *
+   * @return Free heap size in bytes.
+   */
+  uint32_t freeHeap() const;
+
+  /**
+   * @brief Returns the largest allocatable heap block in bytes.
+   *
+   * A shrinking largest block with stable free heap indicates
+   * fragmentation — the failure mode that starves the MQTT buffer
+   * allocation after weeks of uptime.
+   *
+   * @return Largest contiguous free block in bytes.
+   */
+  uint16_t largestHeapBlock() const;
 
 private:
   /**
-   * @brief Establishes a WiFi connection if not already connected.
+   * @brief Connection state machine states.
+   */
+  enum class ConnState : uint8_t {
+    Idle,           /**< Not configured / nothing to do */
+    ConnectingWifi, /**< WiFi.begin() issued, waiting for association */
+    ConnectingMqtt, /**< WiFi up, attempting MQTT connect with backoff */
+    Connected       /**< MQTT session established */
+  };
+
+  /**
+   * @brief Starts a WiFi connection attempt.
+   *
+   * Issues WiFi.begin() and transitions to ConnectingWifi.
+   * Returns immediately; association is monitored from loop().
+   */
+  void startWifi();
+
+  /**
+   * @brief Attempts a single MQTT connection.
+   *
+   * Returns immediately on failure; loop() schedules the next
+   * attempt after the current backoff interval.
+   */
+  void tryMqtt();
+
+  /**
+   * @brief Doubles the reconnect backoff up to its maximum.
+   */
+  void growBackoff();
+
+  /**
+   * @brief Replays every registered topic to the broker in one burst.
+   *
+   * Called from the connect success path; a broker restart with
+   * clean_session=false support missing (or its session store wiped)
+   * would otherwise leave the node connected but subscribed to nothing.
+   */
+  void resubscribeAll();
+
+  /**
+   * @brief Resolves a fallback broker to switch to.
+   *
+   * Prefers the explicitly registered fallback; otherwise queries mDNS
+   * once for a LAN broker advertising _mqtt._tcp and caches the result.
+   *
+   * @return true if a fallback broker is known, false otherwise.
+   */
+  bool resolveFallback();
+
+  /**
+   * @brief Points the MQTT client at the primary or fallback broker.
    *
-   * Handles blocking connection attempts and retries.
+   * @param useFallback true for the fallback broker, false for primary.
    */
-  void connectWifi();
+  void selectBroker(bool useFallback);
 
   /**
-   * @brief Establishes an MQTT connection if not already connected.
+   * @brief One queued publish in the RAM tier of the offline queue.
+   */
+  struct QueuedPublish {
+    char topicSuffix[24];               /**< Topic suffix of the publish */
+    char payload[QUEUE_PAYLOAD_MAX];    /**< Serialized JSON payload */
+    uint16_t length;                    /**< Payload length in bytes */
+  };
+
+  /**
+   * @brief One registered coalescing policy.
+   */
+  struct CoalesceSlot {
+    char topicSuffix[24];  /**< Topic suffix the policy applies to */
+    PublishPolicy policy;  /**< How held publishes are collapsed */
+    uint32_t flushMs;      /**< Maximum hold time (ms) */
+    uint32_t deadline;     /**< Flush deadline of the held publish */
+    bool pending;          /**< A held publish is waiting to flush */
+  };
+
+  /**
+   * @brief Collapses a publish into its topic's coalescing buffer.
    *
-   * Uses stored credentials and base topic information.
+   * @param slot Coalescing slot of the topic.
+   * @param data JSON document of the publish.
+   * @return true if the publish was held or sent, false otherwise.
    */
-  void connectMqtt();
+  bool coalesce(uint8_t slot, const JsonDocument& data);
+
+  /**
+   * @brief Publishes coalescing buffers whose deadline has passed.
+   *
+   * @param force Flush all held publishes regardless of deadline.
+   */
+  void flushCoalesced(bool force = false);
+
+  /**
+   * @brief Publishes a JSON document immediately (pre-coalescing path).
+   *
+   * Wraps the data in the standard envelope and publishes or queues
+   * it; this is the original publishJson() body.
+   *
+   * @param topicSuffix Topic suffix appended to the base topic.
+   * @param data JSON document to serialize and publish.
+   * @return true if the message was published or queued, false otherwise.
+   */
+  bool publishJsonNow(const char* topicSuffix, const JsonDocument& data);
+
+  /**
+   * @brief Queues a serialized publish for delivery after reconnect.
+   *
+   * When the RAM ring is full, its oldest entry is spilled to the
+   * LittleFS-backed log; if an older entry for the same suffix is
+   * already queued it is overwritten instead (newest wins).
+   *
+   * @param topicSuffix Topic suffix of the publish.
+   * @param payload Serialized JSON payload.
+   * @param length Payload length in bytes.
+   * @return true if the message was queued, false otherwise.
+   */
+  bool enqueuePublish(const char* topicSuffix, const char* payload, size_t length);
+
+  /**
+   * @brief Publishes queued messages in batches while connected.
+   *
+   * Drains the flash-backed log first (oldest messages), then the
+   * RAM ring, limited to QUEUE_DRAIN_BATCH messages per call.
+   */
+  void drainQueue();
+
+  /**
+   * @brief Appends a queued publish to the LittleFS-backed log.
+   *
+   * @param entry Queue entry to spill.
+   * @return true if the record was written, false otherwise.
+   */
+  bool spillToFlash(const QueuedPublish& entry);
+
+  /**
+   * @brief Publishes a bounded batch of records from the flash log.
+   *
+   * @param budget Maximum number of records to publish this call.
+   * @return Number of records published.
+   */
+  uint8_t drainFlash(uint8_t budget);
 
   // ---------------------------------------------------------------------------
   // Internal clients
@@ -166,6 +626,15 @@ private:
   /** @brief Underlying WiFi client used by the MQTT client. */
   WiFiClient wifiClient;
 
+  /** @brief TLS client, used instead of wifiClient after enableTls(). */
+  BearSSL::WiFiClientSecure tlsClient;
+
+  /** @brief In-RAM TLS session for abbreviated reconnect handshakes. */
+  BearSSL::Session tlsSession;
+
+  /** @brief Indicates whether the MQTT transport runs over TLS. */
+  bool useTls;
+
   /** @brief PubSubClient instance handling MQTT protocol. */
   PubSubClient mqtt;
 
@@ -197,6 +666,27 @@ private:
   /** @brief MQTT broker port number. */
   uint16_t mqttPort;
 
+  /** @brief Explicit fallback broker hostname, or nullptr. */
+  const char* fallbackHost;
+
+  /** @brief Explicit fallback broker port. */
+  uint16_t fallbackPort;
+
+  /** @brief mDNS-discovered LAN broker address (dotted quad). */
+  char discoveredHost[16];
+
+  /** @brief mDNS-discovered LAN broker port. */
+  uint16_t discoveredPort;
+
+  /** @brief Indicates the client is currently on the fallback broker. */
+  bool onFallback;
+
+  /** @brief Consecutive failed connect attempts to the active broker. */
+  uint8_t failedAttempts;
+
+  /** @brief Timestamp (ms) of the next primary retry while on fallback. */
+  uint32_t primaryRetryAt;
+
   // ---------------------------------------------------------------------------
   // Derived and runtime state
   // ---------------------------------------------------------------------------
@@ -206,8 +696,19 @@ private:
    *
    * Format:
    *   <mqttUser>/<site>/<deviceId>
+   *
+   * Composed once in begin() into a fixed buffer.
    */
-  String baseTopic;
+  char baseTopic[BASE_TOPIC_MAX];
+
+  /** @brief MQTT client ID, composed once in begin(). */
+  char clientId[CLIENT_ID_MAX];
+
+  /** @brief Chip ID as lowercase hex, composed once in begin(). */
+  char chipIdHex[9];
+
+  /** @brief Scratch buffer for makeTopic() composition. */
+  char topicScratch[TOPIC_MAX_LEN];
 
   /**
    * @brief Unique chip identifier.
@@ -215,4 +716,98 @@ private:
    * Used to generate unique MQTT client IDs.
    */
   uint64_t chipId;
+
+  /** @brief Current connection state machine state. */
+  ConnState connState;
+
+  /** @brief Timestamp (ms) of the current WiFi association attempt. */
+  uint32_t wifiAttemptStart;
+
+  /** @brief Timestamp (ms) of the next allowed MQTT connect attempt. */
+  uint32_t nextMqttAttempt;
+
+  /** @brief Current MQTT reconnect backoff interval (ms). */
+  uint32_t backoffMs;
+
+  /**
+   * @brief Precomputed fully qualified topics, indexed by topic ID.
+   *
+   * Filled once by subscribeTopic(); matchTopic() compares against
+   * these entries without allocating.
+   */
+  char topicTable[MAX_TOPICS][TOPIC_MAX_LEN];
+
+  /** @brief Number of valid entries in the topic table. */
+  uint8_t topicCount;
+
+  /** @brief Handler fired after each (re)connect, or nullptr. */
+  ReadyHandler readyHandler;
+
+  /** @brief Maximum number of topics with a registered parse filter. */
+  static constexpr uint8_t MAX_FILTERS = 6;
+
+  /** @brief Capacity (bytes) of each prebuilt filter document. */
+  static constexpr size_t FILTER_DOC_CAPACITY = 256;
+
+  /** @brief Prebuilt deserialization filters, indexed by filter slot. */
+  StaticJsonDocument<FILTER_DOC_CAPACITY> filterDocs[MAX_FILTERS];
+
+  /** @brief Filter slot per topic ID; -1 = parse the topic in full. */
+  int8_t filterSlot[MAX_TOPICS];
+
+  /** @brief Number of filter slots in use. */
+  uint8_t filterCount;
+
+  /** @brief Registered coalescing policies. */
+  CoalesceSlot coalesceSlots[MAX_COALESCED];
+
+  /** @brief Held publish data per coalescing slot. */
+  StaticJsonDocument<COALESCE_DOC_SIZE> coalesceDocs[MAX_COALESCED];
+
+  /** @brief Number of coalescing slots in use. */
+  uint8_t coalesceCount;
+
+  /** @brief Topic suffixes routed to the telemetry lane. */
+  char telemetryTopics[MAX_TELEMETRY][24];
+
+  /** @brief Number of telemetry lane entries in use. */
+  uint8_t telemetryCount;
+
+  /**
+   * @brief Checks whether a topic suffix rides the telemetry lane.
+   *
+   * @param topicSuffix Topic suffix of a publish.
+   * @return true if the suffix is registered as telemetry.
+   */
+  bool isTelemetry(const char* topicSuffix) const;
+
+  /** @brief RAM tier of the offline publish queue (ring buffer). */
+  QueuedPublish queue[QUEUE_CAPACITY];
+
+  /** @brief Index of the oldest queued entry. */
+  uint8_t queueHead;
+
+  /** @brief Number of entries currently in the RAM queue. */
+  uint8_t queueCount;
+
+  /** @brief Indicates whether the flash log holds spilled publishes. */
+  bool flashQueued;
+
+  /** @brief Byte offset of the next unsent record in the flash log. */
+  uint32_t flashReadOffset;
+
+  /** @brief Indicates whether LittleFS mounted successfully. */
+  bool fsReady;
+
+  /** @brief Monotonically increasing publish sequence number. */
+  uint32_t publishSeq;
+
+  /** @brief Number of message keys in the duplicate-suppression window. */
+  static constexpr uint8_t SEEN_WINDOW = 8;
+
+  /** @brief Recently seen message keys (ring, newest overwrites oldest). */
+  uint32_t seenKeys[SEEN_WINDOW];
+
+  /** @brief Next write slot in the seen-key ring. */
+  uint8_t seenIndex;
 };
@@ -1,140 +1,484 @@
-/* This example shows how to use MQTT on the main dev boards on the market
- * HOW TO USE:
- * under connect method, add your subscribe channels.
- * under messageReceived (callback method) add actions to be done when a msg is received.
- * to publish, call client.publish(topic,msg)
- * in loop take care of using non-blocking method or it will corrupt.
- * 
- * Alberto Perro - Officine Innesto 2019
- * Edited and adapted for Environmental Shield and Relay Carrier by Davide Gomba
+/**
+ * @file test.ino
+ * @brief Hardware-in-the-loop latency benchmark harness.
+ *
+ * @defgroup bench Benchmark harness
+ * @{
+ *
+ * @details
+ * Flash this sketch onto a spare ESP8266 to exercise the real access
+ * control system and put numbers on its end-to-end latencies. The
+ * harness joins the measured door's MQTT topic space (same device ID;
+ * the client ID stays unique via the chip ID) and replays recorded
+ * card scans and keypad traffic against the live nodes:
+ *
+ * - Card-to-decision: inject an access/request with a recorded UID,
+ *   wait for the matching access/response
+ * - Key-to-beep: publish a keypad/tap, wait for the keypad/beep relay
+ * - Grant-to-servo: submit the PIN, wait for the actuator's
+ *   servo_seated event on door/servo_state
+ *
+ * All intervals are measured with micros() on this board, so no clock
+ * synchronization with the measured nodes is needed. After each run a
+ * percentile summary (p50/p90/p99/max) per metric is printed over
+ * Serial and published on bench/report.
+ *
+ * Driving the RC522 SPI bus directly is not possible from a separate
+ * board, so scans are injected as the same MQTT access/request esp1
+ * publishes; the esp1-internal card-to-publish time is covered by the
+ * nodes' own metrics/latency reports.
+ *
+ * Start a run by sending 'b' over Serial (or any message on
+ * bench/start).
  */
- 
-#define BROKER_IP    "192.168.0.119" // important: you have to change this to your IP brocker Addres
-#define DEV_NAME     "mqttdevice"
-#define MQTT_USER    "mqtt_user"
-#define MQTT_PW      "mqtt_password"
-
-const char ssid[] = "SECRET_SSID";
-const char pass[] = "SECRET_PASSWORD";
-
-#include <MQTT.h>
-#include <Arduino_MKRENV.h>
-
-#ifdef ARDUINO_SAMD_MKRWIFI1010
-#include <WiFiNINA.h>
-#elif ARDUINO_SAMD_MKR1000
-#include <WiFi101.h>
-#else
-#error unknown board
-#endif
-
-int R1 = 1;
-int R2 = 2;
-int led =  LED_BUILTIN;
-uint32_t elaps = 0;
-
-WiFiClient net;
-MQTTClient client;
-unsigned long lastMillis = 0;
-
-void connect() {
-  Serial.print("checking wifi...");
-  while (WiFi.status() != WL_CONNECTED) {
-    Serial.print(".");
-    delay(1000);
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include <WiFiMqttClient.h>
+
+// ---------------- Network configuration ----------------
+
+/** @brief WiFi + MQTT client wrapper */
+WifiMqttClient net;
+
+/** @brief WiFi SSID */
+constexpr char WIFI_SSID[] = "Mathias2.4";
+/** @brief WiFi password */
+constexpr char WIFI_PASS[] = "mrbombasticcallmefantastic";
+
+/** @brief MQTT broker hostname */
+constexpr char MQTT_HOST[] = "maqiatto.com";
+/** @brief MQTT broker port */
+constexpr uint16_t MQTT_PORT = 1883;
+/** @brief MQTT username */
+constexpr char MQTT_USER[] = "hectorfoss@gmail.com";
+/** @brief MQTT password */
+constexpr char MQTT_PASS[] = "potter";
+
+/**
+ * @brief Device identifier of the door under test.
+ *
+ * Using the measured door's ID puts the harness inside its topic
+ * space; the MQTT client ID stays unique because it includes the
+ * chip ID.
+ */
+constexpr char DEVICE_ID[] = "door1";
+
+// -----------------------------------------------------------------------------
+// Benchmark configuration
+// -----------------------------------------------------------------------------
+
+/** @brief Recorded UIDs replayed against the door (known-good cards). */
+const char* const REPLAY_UIDS[] = {
+  "04A3B2C1D4",
+  "04D4C3B2A1",
+};
+
+/** @brief Number of recorded UIDs. */
+constexpr uint8_t REPLAY_UID_COUNT =
+  sizeof(REPLAY_UIDS) / sizeof(REPLAY_UIDS[0]);
+
+/** @brief PIN submitted on the keypad path. */
+constexpr char REPLAY_PIN[] = "1234";
+
+/** @brief Trials per benchmark run. */
+constexpr uint8_t TRIALS = 20;
+
+/** @brief Pause (ms) between trials, letting the door relock. */
+constexpr uint32_t TRIAL_COOLDOWN_MS = 6000;
+
+/** @brief Per-phase timeout (ms); a timed-out phase voids the trial. */
+constexpr uint32_t PHASE_TIMEOUT_MS = 10000;
+
+// -----------------------------------------------------------------------------
+// Latency sample stores
+// -----------------------------------------------------------------------------
+
+/** @brief Measured intervals, one store per metric. */
+enum class BenchMetric : uint8_t {
+  CardToDecision = 0,  /**< access/request -> access/response */
+  KeyToBeep,           /**< keypad/tap -> keypad/beep */
+  GrantToServo,        /**< keypad/submit -> servo_seated */
+  Count
+};
+
+/** @brief Metric names for the report, in BenchMetric order. */
+const char* const METRIC_NAMES[] = {
+  "card_to_decision",
+  "key_to_beep",
+  "grant_to_servo",
+};
+
+/** @brief Maximum stored samples per metric. */
+constexpr uint8_t MAX_SAMPLES = TRIALS;
+
+/** @brief Collected samples (us). */
+uint32_t samples[(uint8_t)BenchMetric::Count][MAX_SAMPLES];
+
+/** @brief Number of valid samples per metric. */
+uint8_t sampleCount[(uint8_t)BenchMetric::Count];
+
+/**
+ * @brief Stores one measured interval.
+ *
+ * @param metric Metric the interval belongs to.
+ * @param us Interval in microseconds.
+ */
+void recordSample(BenchMetric metric, uint32_t us) {
+  const uint8_t m = (uint8_t)metric;
+  if (sampleCount[m] >= MAX_SAMPLES) return;
+
+  samples[m][sampleCount[m]++] = us;
+}
+
+/**
+ * @brief Returns the given percentile of a sorted sample array.
+ *
+ * @param sorted Ascending samples.
+ * @param n Number of samples.
+ * @param pct Percentile (0..100).
+ * @return Sample value at the percentile rank.
+ */
+uint32_t percentile(const uint32_t* sorted, uint8_t n, uint8_t pct) {
+  if (n == 0) return 0;
+
+  uint16_t rank = ((uint16_t)pct * (n - 1) + 50) / 100;
+  return sorted[rank];
+}
+
+/**
+ * @brief Sorts samples ascending (insertion sort; n is tiny).
+ *
+ * @param values Sample array, sorted in place.
+ * @param n Number of samples.
+ */
+void sortSamples(uint32_t* values, uint8_t n) {
+  for (uint8_t i = 1; i < n; i++) {
+    const uint32_t v = values[i];
+    uint8_t j = i;
+    while (j > 0 && values[j - 1] > v) {
+      values[j] = values[j - 1];
+      j--;
+    }
+    values[j] = v;
   }
+}
+
+// -----------------------------------------------------------------------------
+// Trial state machine
+// -----------------------------------------------------------------------------
+
+/** @brief Phases of a single benchmark trial. */
+enum class BenchPhase : uint8_t {
+  Idle,          /**< No run in progress */
+  WaitDecision,  /**< access/request sent, awaiting access/response */
+  WaitBeep,      /**< keypad/tap sent, awaiting keypad/beep */
+  WaitServo,     /**< keypad/submit sent, awaiting servo_seated */
+  Cooldown       /**< Trial done, letting the door relock */
+};
+
+/** @brief Current trial phase. */
+BenchPhase phase = BenchPhase::Idle;
+
+/** @brief Completed trials in the current run. */
+uint8_t trialsDone = 0;
+
+/** @brief micros() timestamp when the current phase started. */
+uint32_t phaseStartUs = 0;
+
+/** @brief millis() deadline of the current phase or cooldown. */
+uint32_t phaseDeadline = 0;
+
+/** @brief Correlation ID of the in-flight access request. */
+uint32_t pendingSeq = 0;
+
+// -----------------------------------------------------------------------------
+// Topic IDs (assigned by WifiMqttClient::subscribeTopic() in setup())
+// -----------------------------------------------------------------------------
 
-  Serial.print("\nconnecting...");
-  while (!client.connect(DEV_NAME, MQTT_USER, MQTT_PW)) {
-    Serial.print(".");
-    delay(1000);
+/** @brief Topic ID for "access/response". */
+int8_t topicAccessResponse = -1;
+
+/** @brief Topic ID for "keypad/beep". */
+int8_t topicKeypadBeep = -1;
+
+/** @brief Topic ID for "door/servo_state". */
+int8_t topicServoState = -1;
+
+/** @brief Topic ID for "bench/start" (remote run trigger). */
+int8_t topicBenchStart = -1;
+
+// -----------------------------------------------------------------------------
+// Trial driving
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Injects the next recorded scan and arms the decision timer.
+ */
+void startTrial() {
+  StaticJsonDocument<64> data;
+  data["uid"]   = REPLAY_UIDS[trialsDone % REPLAY_UID_COUNT];
+  data["event"] = "RFID_Try";
+
+  phaseStartUs = micros();
+  net.publishJson("access/request", data);
+  pendingSeq = net.lastSeq();
+
+  phase = BenchPhase::WaitDecision;
+  phaseDeadline = millis() + PHASE_TIMEOUT_MS;
+}
+
+/**
+ * @brief Starts a benchmark run from the beginning.
+ */
+void startRun() {
+  for (uint8_t m = 0; m < (uint8_t)BenchMetric::Count; m++) {
+    sampleCount[m] = 0;
   }
-  Serial.println("\nconnected!");
-  //client.subscribe("/hello"); //SUBSCRIBE TO TOPIC /hello
-  client.subscribe("/relay1"); //SUBSCRIBE TO TOPIC /hello
-  client.subscribe("/relay2"); //SUBSCRIBE TO TOPIC /hello
 
+  trialsDone = 0;
+  Serial.printf("Benchmark: starting %u trials\n", TRIALS);
+  startTrial();
+}
 
-  client.subscribe("/temp"); //SUBSCRIBE TO TOPIC /t
-  client.subscribe("/humidity"); //SUBSCRIBE TO TOPIC /h
-  client.subscribe("/pressure"); //SUBSCRIBE TO TOPIC /p
-  client.subscribe("/light"); //SUBSCRIBE TO TOPIC /l
+/**
+ * @brief Ends the current trial and schedules the next one.
+ *
+ * @param voided true if the trial timed out and produced no samples.
+ */
+void finishTrial(bool voided) {
+  if (voided) {
+    Serial.printf("Benchmark: trial %u voided (timeout in phase %u)\n",
+                  trialsDone + 1, (uint8_t)phase);
+  }
+
+  trialsDone++;
+  phase = BenchPhase::Cooldown;
+  phaseDeadline = millis() + TRIAL_COOLDOWN_MS;
 }
-void messageReceived(String &topic, String &payload) {
-  Serial.println("incoming: " + topic + " - " + payload);
 
-  if (topic == "/relay1") {
-    if (payload == "true") {
-      digitalWrite(R1, HIGH);
-      digitalWrite(led, HIGH);
+/**
+ * @brief Prints and publishes the percentile summary of a run.
+ */
+void publishReport() {
+  StaticJsonDocument<512> data;
 
-    } else if (payload == "false") {
+  Serial.println("--- benchmark report (us) ---");
 
-      digitalWrite(R1, LOW);
-      digitalWrite(led, LOW);
-    }
+  for (uint8_t m = 0; m < (uint8_t)BenchMetric::Count; m++) {
+    const uint8_t n = sampleCount[m];
+    if (n == 0) continue;
+
+    sortSamples(samples[m], n);
+
+    JsonObject entry = data.createNestedObject(METRIC_NAMES[m]);
+    entry["n"]   = n;
+    entry["p50"] = percentile(samples[m], n, 50);
+    entry["p90"] = percentile(samples[m], n, 90);
+    entry["p99"] = percentile(samples[m], n, 99);
+    entry["max"] = samples[m][n - 1];
+
+    Serial.printf("%-16s n=%2u p50=%8lu p90=%8lu p99=%8lu max=%8lu\n",
+                  METRIC_NAMES[m], n,
+                  (unsigned long)percentile(samples[m], n, 50),
+                  (unsigned long)percentile(samples[m], n, 90),
+                  (unsigned long)percentile(samples[m], n, 99),
+                  (unsigned long)samples[m][n - 1]);
   }
 
-  if (topic == "/relay2") {
-    if (payload == "true") {
-      digitalWrite(R2, HIGH);
-      digitalWrite(led, HIGH);
+  net.publishJson("bench/report", data);
+}
+
+// -----------------------------------------------------------------------------
+// MQTT callback
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief MQTT message callback handler.
+ *
+ * Closes the measurement interval of the phase the trial is in and
+ * advances the trial state machine.
+ *
+ * @param topic MQTT topic string.
+ * @param payload Raw payload bytes.
+ * @param length Payload length.
+ */
+void callback(char* topic, byte* payload, unsigned int length) {
+  const uint32_t nowUs = micros();
+
+  if (length == 0) return;
+
+  const int8_t topicId = net.matchTopic(topic);
+  if (topicId < 0) return;
+
+  // Binary frames (session/state sync) are not used by the harness
+  if (PackedReader::isPacked(payload, length)) return;
 
-    } else if (payload == "false") {
+  StaticJsonDocument<512> doc;
 
-      digitalWrite(R2, LOW);
-      digitalWrite(led, LOW);
+  // Filtered in-situ parse: only the declared fields are materialized
+  if (net.parseJson(topicId, payload, length, doc)) return;
+
+  // ---------------------------------------------------------------------------
+  // Remote run trigger
+  // ---------------------------------------------------------------------------
+  if (topicId == topicBenchStart) {
+    if (phase == BenchPhase::Idle) startRun();
+    return;
+  }
+
+  // ---------------------------------------------------------------------------
+  // Access decision: card-to-decision sample, then drive the keypad
+  // ---------------------------------------------------------------------------
+  if (topicId == topicAccessResponse && phase == BenchPhase::WaitDecision) {
+
+    // Only accept the response to our own injected request
+    uint32_t seq = doc["seq"] | 0;
+    if (seq != 0 && seq != pendingSeq) return;
+
+    recordSample(BenchMetric::CardToDecision, nowUs - phaseStartUs);
+
+    if (!(doc["response"]["hasAccess"] | false)) {
+      Serial.println("Benchmark: replay UID rejected, voiding trial");
+      finishTrial(true);
+      return;
     }
+
+    // Drive one keypad tap next
+    StaticJsonDocument<64> data;
+    data["event"]     = "KP_tap";
+    data["pinlength"] = 1;
+
+    phaseStartUs = micros();
+    net.publishJson("keypad/tap", data);
+
+    phase = BenchPhase::WaitBeep;
+    phaseDeadline = millis() + PHASE_TIMEOUT_MS;
   }
 
+  // ---------------------------------------------------------------------------
+  // Beep relay: key-to-beep sample, then submit the PIN
+  // ---------------------------------------------------------------------------
+  else if (topicId == topicKeypadBeep && phase == BenchPhase::WaitBeep) {
+
+    recordSample(BenchMetric::KeyToBeep, nowUs - phaseStartUs);
+
+    StaticJsonDocument<64> data;
+    data["event"] = "KP_try";
+    data["code"]  = REPLAY_PIN;
+
+    phaseStartUs = micros();
+    net.publishJson("keypad/submit", data);
+
+    phase = BenchPhase::WaitServo;
+    phaseDeadline = millis() + PHASE_TIMEOUT_MS;
+  }
+
+  // ---------------------------------------------------------------------------
+  // Actuator seated: grant-to-servo sample, trial complete
+  // ---------------------------------------------------------------------------
+  else if (topicId == topicServoState && phase == BenchPhase::WaitServo) {
+
+    const char* event = doc["data"]["event"] | "";
+    if (strcmp(event, "servo_seated") != 0) return;
+
+    recordSample(BenchMetric::GrantToServo, nowUs - phaseStartUs);
+    finishTrial(false);
+  }
 }
+
+// -----------------------------------------------------------------------------
+// Setup
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Arduino setup function.
+ *
+ * Initializes Serial output, WiFi, MQTT, and topic subscriptions.
+ */
 void setup() {
+  delay(100);
   Serial.begin(115200);
-  WiFi.begin(ssid, pass);
-
-  // Note: Local domain names (e.g. "Computer.local" on OSX) are not supported by Arduino.
-  // You need to set the IP address directly.
-  //
-  // MQTT brokers usually use port 8883 for secure connections.
-  client.begin(BROKER_IP, 1883, net);
-  client.onMessage(messageReceived);
-  connect();
-
-  pinMode(led, OUTPUT);
-  pinMode(R1, OUTPUT);
-  pinMode(R2, OUTPUT);
-
-  if (!ENV.begin()) {
-    Serial.println("Failed to initialize MKR ENV shield!");
-    while (1);
-  }
 
-}
+  net.begin(
+    WIFI_SSID,
+    WIFI_PASS,
+    MQTT_HOST,
+    MQTT_PORT,
+    MQTT_USER,
+    MQTT_PASS,
+    DEVICE_ID,
+    "site1"
+  );
 
-void loop() {
+  Serial.println("Benchmark harness ready (send 'b' to start)");
 
-  // read enrivornmental data
+  net.setCallback(callback);
 
-  float t = ENV.readTemperature();
-  float h = ENV.readHumidity();
-  float p = ENV.readPressure();
-  float l = ENV.readLux();
+  topicAccessResponse = net.subscribeTopic("access/response");
+  Serial.printf("access/response MQTT subscribe %s\n",
+    topicAccessResponse >= 0 ? "OK" : "FAILED");
 
-  client.loop();
-  if (!client.connected()) {
-    connect();
-  }
-  // publish a message roughly every second.
-  if (millis() - lastMillis > 1000) {
-    lastMillis = millis();
-    client.publish("/hello", "world"); //PUBLISH TO TOPIC /hello MSG world
-    client.publish("/temp", String(t)); //SUBSCRIBE TO TOPIC /temp, pass the value as a string
-    client.publish("/humidity", String(h)); //SUBSCRIBE TO TOPIC /humidity, pass the value as a string
-    client.publish("/pressure", String(p)); //SUBSCRIBE TO TOPIC /pressure, pass the value as a string
-    client.publish("/light", String(l)); //SUBSCRIBE TO TOPIC /light, pass the value as a string
+  topicKeypadBeep = net.subscribeTopic("keypad/beep");
+  Serial.printf("keypad/beep MQTT subscribe %s\n",
+    topicKeypadBeep >= 0 ? "OK" : "FAILED");
+
+  topicServoState = net.subscribeTopic("door/servo_state");
+  Serial.printf("door/servo_state MQTT subscribe %s\n",
+    topicServoState >= 0 ? "OK" : "FAILED");
+
+  topicBenchStart = net.subscribeTopic("bench/start");
+  Serial.printf("bench/start MQTT subscribe %s\n",
+    topicBenchStart >= 0 ? "OK" : "FAILED");
+
+  // Parse filters: the harness only correlates and timestamps, so it
+  // reads at most three fields out of any message
+  net.filterTopic(topicAccessResponse, "seq response.hasAccess");
+  net.filterTopic(topicServoState, "data.event");
+}
+
+// -----------------------------------------------------------------------------
+// Main loop
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Arduino main loop.
+ *
+ * Handles MQTT traffic, phase timeouts, trial pacing, and the Serial
+ * run trigger.
+ */
+void loop() {
+  net.loop();
+  yield();
+
+  // Serial trigger: 'b' starts a run when idle
+  if (Serial.available() && Serial.read() == 'b' &&
+      phase == BenchPhase::Idle) {
+    startRun();
   }
 
+  if (phase == BenchPhase::Idle) return;
+
+  const uint32_t now = millis();
 
+  // Cooldown elapsed: next trial or final report
+  if (phase == BenchPhase::Cooldown) {
+    if ((int32_t)(now - phaseDeadline) >= 0) {
+      if (trialsDone >= TRIALS) {
+        publishReport();
+        phase = BenchPhase::Idle;
+      } else {
+        startTrial();
+      }
+    }
+    return;
+  }
 
+  // Waiting phases: a timeout voids the trial
+  if ((int32_t)(now - phaseDeadline) >= 0) {
+    finishTrial(true);
+  }
+}
 
-}
\ No newline at end of file
+/** @} */